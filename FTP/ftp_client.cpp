@@ -3,7 +3,8 @@
  *
  * Objetivo: Aprendizagem dos protocolos de rede
  *
- * Compilar: g++ -std=c++17 -Wall ftp_client.cpp -o ftp_client
+ * Compilar: g++ -std=c++17 -Wall -pthread ftp_client.cpp -o ftp_client
+ * Com tempos por fase (comando trace): -DPROTOCOLS_TRACE
  * Executar: ./ftp_client <servidor> [porta]
  *
  *
@@ -42,17 +43,237 @@ Conceitos de FTP aprendidos:
 #include <netdb.h>
 #include <fstream>
 #include <memory>
+#include <functional>
+#include <chrono>
+#include <cerrno>
+#include <cstdlib>
+#include <cstdint>
+#include <iomanip>
+#include <random>
+#include <algorithm>
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <thread>
+#include <atomic>
+#include <mutex>
+#include <condition_variable>
+#include <deque>
+#include <fnmatch.h>
+#include <poll.h>
+#include <map>
+#include <ctime>
+#ifdef __linux__
+#include <sys/sendfile.h>
+#endif
+#include "../common/dns_resolver.h"
+#include "../common/phase_trace.h"
+#include "../common/socket_io.h"
+
+// Resposta do canal de controle: código e todas as linhas (sem CRLF)
+struct FTPReply {
+    int code = 0;
+    std::vector<std::string> lines;
+
+    bool preliminary() const { return code >= 100 && code < 200; }
+    bool completion() const { return code >= 200 && code < 300; }
+    bool intermediate() const { return code >= 300 && code < 400; }
+    bool transient() const { return code >= 400 && code < 500; }
+    bool permanent() const { return code >= 500 && code < 600; }
+
+    std::string text() const {
+        std::string joined;
+        for (const std::string& line : lines) {
+            if (!joined.empty()) {
+                joined += '\n';
+            }
+            joined += line;
+        }
+        return joined;
+    }
+};
+
+inline std::ostream& operator<<(std::ostream& out, const FTPReply& reply) {
+    return out << (reply.lines.empty() ? "(sem resposta)" : reply.text());
+}
+
+// Entrada de MLSD/MLST: "type=file;size=1024;modify=20240101120000; nome"
+struct FTPEntry {
+    std::string name;
+    std::string type;       // file, dir, cdir, pdir, OS.unix=slink...
+    int64_t size = -1;      // -1 se o servidor não informou
+    std::string modify;     // YYYYMMDDHHMMSS[.sss] em UTC
+    time_t modify_time = 0;
+    std::map<std::string, std::string> facts;  // todos os fatos, chaves em minúsculas
+
+    bool is_directory() const { return type == "dir" || type == "cdir" || type == "pdir"; }
+
+    static bool parse(const std::string& raw, FTPEntry& entry) {
+        std::string line = raw;
+        if (!line.empty() && line.back() == '\r') {
+            line.pop_back();
+        }
+        // Linhas de MLST vêm com um espaço inicial
+        size_t begin = line.find_first_not_of(' ');
+        size_t separator = line.find(' ', begin);
+        if (begin == std::string::npos || separator == std::string::npos ||
+            separator + 1 >= line.size()) {
+            return false;
+        }
+
+        entry = FTPEntry();
+        entry.name = line.substr(separator + 1);
+
+        size_t position = begin;
+        while (position < separator) {
+            size_t end = line.find(';', position);
+            if (end == std::string::npos || end > separator) {
+                end = separator;
+            }
+            size_t equals = line.find('=', position);
+            if (equals != std::string::npos && equals < end) {
+                std::string key = line.substr(position, equals - position);
+                std::transform(key.begin(), key.end(), key.begin(), ::tolower);
+                entry.facts[key] = line.substr(equals + 1, end - equals - 1);
+            }
+            position = end + 1;
+        }
+
+        auto fact = entry.facts.find("type");
+        if (fact != entry.facts.end()) {
+            entry.type = fact->second;
+            std::transform(entry.type.begin(), entry.type.end(), entry.type.begin(), ::tolower);
+        }
+        fact = entry.facts.find("size");
+        if (fact == entry.facts.end()) {
+            fact = entry.facts.find("sizd");
+        }
+        if (fact != entry.facts.end()) {
+            entry.size = std::strtoll(fact->second.c_str(), nullptr, 10);
+        }
+        fact = entry.facts.find("modify");
+        if (fact != entry.facts.end() && fact->second.size() >= 14) {
+            entry.modify = fact->second;
+            struct tm parts{};
+            parts.tm_year = std::atoi(entry.modify.substr(0, 4).c_str()) - 1900;
+            parts.tm_mon = std::atoi(entry.modify.substr(4, 2).c_str()) - 1;
+            parts.tm_mday = std::atoi(entry.modify.substr(6, 2).c_str());
+            parts.tm_hour = std::atoi(entry.modify.substr(8, 2).c_str());
+            parts.tm_min = std::atoi(entry.modify.substr(10, 2).c_str());
+            parts.tm_sec = std::atoi(entry.modify.substr(12, 2).c_str());
+            entry.modify_time = timegm(&parts);
+        }
+        return true;
+    }
+};
 
 class FTPClient {
+public:
+    // Progresso: bytes transferidos, total (0 se desconhecido) e taxa média
+    using ProgressCallback = std::function<void(uint64_t transferred, uint64_t total,
+                                                double bytes_per_second)>;
+
+    // Resultado da última transferência de dados
+    struct TransferStats {
+        uint64_t bytes = 0;
+        double seconds = 0;
+        // connect: canal de dados; write: comando enviado; first_byte: resposta
+        // 1xx; transfer: resposta final. Bytes e chamadas só do canal de dados.
+        PhaseTrace trace;
+
+        double bytes_per_second() const { return seconds > 0 ? bytes / seconds : 0; }
+    };
+
 private:
-    int control_socket;
-    int data_socket;
+    Socket control_socket;
+    Socket data_socket;
     std::string server;
     int port;
     bool passive_mode;
 
+    // Buffer fixo reutilizado quando splice não está disponível
+    std::vector<char> transfer_buffer;
+    ProgressCallback progress_callback;
+    TransferStats last_transfer;
+    // Fases da transferência em andamento e da conexão de controle
+    PhaseTrace transfer_trace;
+    PhaseTrace session_trace;
+    // Destino opcional dos traces de cada transferência concluída
+    TraceWriter* trace_output = nullptr;
+    std::string transfer_command;
+    uint64_t rate_limit = 0;
+    bool verbose = true;
+    int last_code = 0;
+
+    bool pipelining = false;
+    bool epsv_supported = true;
+    // data_socket já conectado para a próxima transferência (modo pipelined)
+    bool data_ready = false;
+
+    // Listagens MLSD por diretório (chave: caminho como passado ao MLSD)
+    std::map<std::string, std::vector<FTPEntry>> directory_cache;
+    bool prefetch_pending = false;
+    static constexpr int DATA_CONNECT_TIMEOUT_MS = 10000;
+
+    // Bytes recebidos no canal de controle ainda não consumidos
+    ReceiveBuffer control_buffer;
+    size_t control_scanned = 0;
+    // Opções de socket das conexões de controle e de dados
+    SocketTuning tuning;
+    static constexpr size_t MAX_CONTROL_LINE = 64 * 1024;
+
+    // Credenciais do último login bem-sucedido
+    std::string username;
+    std::string password;
+
 public:
-    FTPClient() : control_socket(-1), data_socket(-1), port(21), passive_mode(false) {}
+    // TYPE A (texto, com conversão CRLF pelo servidor) ou TYPE I (imagem/binário)
+    enum class TransferType { ASCII, BINARY };
+
+private:
+    TransferType transfer_type = TransferType::BINARY;
+    bool type_negotiated = false;
+
+public:
+    static constexpr size_t TRANSFER_CHUNK = 256 * 1024;
+
+    FTPClient() : port(21), passive_mode(false) {}
+
+    // Desliga as mensagens de sucesso no stdout (sessões auxiliares)
+    void set_verbose(bool enabled) {
+        verbose = enabled;
+    }
+
+    // Limite de taxa para uploads em bytes/s (0 = sem limite)
+    void set_rate_limit(uint64_t bytes_per_second) {
+        rate_limit = bytes_per_second;
+    }
+
+    void set_progress_callback(ProgressCallback callback) {
+        progress_callback = std::move(callback);
+    }
+
+    // Vale para as próximas conexões (controle no connect, dados a cada PASV/EPSV)
+    void set_socket_tuning(const SocketTuning& value) {
+        tuning = value;
+    }
+
+    const SocketTuning& get_socket_tuning() const {
+        return tuning;
+    }
+
+    const TransferStats& last_transfer_stats() const {
+        return last_transfer;
+    }
+
+    // DNS, connect e banner (first_byte) da conexão de controle
+    const PhaseTrace& connect_trace() const {
+        return session_trace;
+    }
+
+    // Cada transferência concluída é registrada com comando, servidor e código
+    void set_trace_output(TraceWriter* output) {
+        trace_output = output;
+    }
 
     ~FTPClient() {
         disconnect();
@@ -61,38 +282,35 @@ public:
     bool connect(const std::string& server, int port = 21) {
         this->server = server;
         this->port = port;
+        session_trace.begin();
 
-        // Criar socket de controle
-        control_socket = socket(AF_INET, SOCK_STREAM, 0);
-        if (control_socket < 0) {
-            std::cerr << "Erro ao criar socket" << std::endl;
-            return false;
-        }
-
-        // Resolver nome do servidor
-        struct hostent* host = gethostbyname(server.c_str());
-        if (!host) {
-            std::cerr << "Erro ao resolver servidor: " << server << std::endl;
+        // Resolver nome do servidor (cache compartilhado, IPv4 e IPv6)
+        std::string error;
+        DNSResolver::Addresses addresses = DNSResolver::shared().resolve(server, port, &error);
+        if (addresses.empty()) {
+            std::cerr << error << std::endl;
             return false;
         }
-
-        // Configurar endereço do servidor
-        struct sockaddr_in server_addr{};
-        server_addr.sin_family = AF_INET;
-        server_addr.sin_port = htons(port);
-        memcpy(&server_addr.sin_addr, host->h_addr, host->h_length);
-
-        // Conectar
-        if (::connect(control_socket, (struct sockaddr*)&server_addr, sizeof(server_addr)) < 0) {
-            std::cerr << "Erro ao conectar com " << server << ":" << port << std::endl;
+        session_trace.mark(TracePhase::DNS);
+
+        // Conectar socket de controle (Happy Eyeballs entre os endereços)
+        control_socket.reset(happy_eyeballs_connect(addresses, std::chrono::seconds(10),
+                                                    std::chrono::milliseconds(250), &error,
+                                                    [this](int fd) { apply_tuning(fd, tuning); }));
+        if (!control_socket) {
+            std::cerr << "Erro ao conectar com " << server << ":" << port << ": " << error << std::endl;
             return false;
         }
+        session_trace.mark(TracePhase::CONNECT);
 
         // Ler resposta inicial do servidor
-        std::string response = read_response();
-        std::cout << "Conectado: " << response;
+        FTPReply response = read_response();
+        session_trace.mark(TracePhase::FIRST_BYTE);
+        if (verbose) {
+            std::cout << "Conectado: " << response << std::endl;
+        }
 
-        if (response.substr(0, 3) != "220") {
+        if (response.code != 220) {
             std::cerr << "Resposta inesperada do servidor" << std::endl;
             return false;
         }
@@ -101,58 +319,550 @@ public:
     }
 
     void disconnect() {
-        if (control_socket >= 0) {
+        if (control_socket.valid()) {
             send_command("QUIT");
-            close(control_socket);
-            control_socket = -1;
-        }
-        if (data_socket >= 0) {
-            close(data_socket);
-            data_socket = -1;
+            control_socket.reset();
         }
+        data_socket.reset();
+        data_ready = false;
     }
 
     bool login(const std::string& username, const std::string& password) {
         // Enviar USER
-        std::string response = send_command("USER " + username);
-        if (response.substr(0, 3) != "331") {
+        FTPReply response = send_command("USER " + username);
+        if (response.code != 331) {
             std::cerr << "Erro no usuário: " << response << std::endl;
             return false;
         }
 
         // Enviar PASS
         response = send_command("PASS " + password);
-        if (response.substr(0, 3) != "230") {
+        if (response.code != 230) {
             std::cerr << "Erro na senha: " << response << std::endl;
             return false;
         }
 
-        std::cout << "Login realizado com sucesso!" << std::endl;
+        if (verbose) {
+            std::cout << "Login realizado com sucesso!" << std::endl;
+        }
+        type_negotiated = false;
+
+        // Guardadas para abrir sessões adicionais (downloads segmentados)
+        this->username = username;
+        this->password = password;
+        return true;
+    }
+
+    // Define o tipo usado em RETR/STOR; o TYPE só é enviado quando muda
+    bool set_transfer_type(TransferType type) {
+        if (type_negotiated && type == transfer_type) {
+            return true;
+        }
+
+        FTPReply response = send_command(type == TransferType::BINARY ? "TYPE I" : "TYPE A");
+        if (response.code != 200) {
+            std::cerr << "Erro no TYPE: " << response << std::endl;
+            type_negotiated = false;
+            return false;
+        }
+
+        transfer_type = type;
+        type_negotiated = true;
+        return true;
+    }
+
+    bool delete_file(const std::string& remote_file) {
+        FTPReply response = send_command("DELE " + remote_file);
+        invalidate_directory(parent_directory(remote_file));
+        if (response.code != 250) {
+            std::cerr << "Erro no DELE: " << response << std::endl;
+            return false;
+        }
         return true;
     }
 
+    TransferType get_transfer_type() const {
+        return transfer_type;
+    }
+
+    // Comandos enviados sem esperar cada resposta (TYPE/EPSV/REST/RETR num
+    // único write) e canal de dados da próxima transferência aberto logo
+    // após o fim da atual. Desligado por padrão: nem todo servidor aceita.
+    void set_pipelining(bool enabled) {
+        pipelining = enabled;
+    }
+
+    bool get_pipelining() const {
+        return pipelining;
+    }
+
+    // Abre o canal de dados: EPSV (RFC 2428) e, se o servidor não suportar, PASV.
+    // Um canal pré-aberto pelo modo pipelined é reaproveitado.
     bool set_passive_mode() {
-        std::string response = send_command("PASV");
-        if (response.substr(0, 3) != "227") {
-            std::cerr << "Erro ao ativar modo passivo: " << response << std::endl;
+        if (data_ready) {
+            data_ready = false;
+            return true;
+        }
+
+        while (true) {
+            bool extended = epsv_supported;
+            FTPReply response = send_command(passive_command());
+            if (open_passive(response) && finish_data_connect()) {
+                passive_mode = true;
+                return true;
+            }
+            // EPSV rejeitado: tentar de novo com PASV
+            if (!extended || epsv_supported) {
+                std::cerr << "Erro ao ativar modo passivo: " << response << std::endl;
+                return false;
+            }
+        }
+    }
+
+    std::string list_files() {
+        FTPReply response = start_transfer("LIST", false);
+        if (!response.preliminary()) {
+            std::cerr << "Erro no LIST: " << response << std::endl;
+            return "";
+        }
+
+        // Ler dados do socket de dados
+        std::string file_list = read_data();
+        data_socket.reset();
+
+        // Ler resposta final
+        finish_transfer();
+
+        return file_list;
+    }
+
+    // RETR gravando direto no disco à medida que os dados chegam (memória constante).
+    // Com offset > 0, envia REST e continua o arquivo local a partir dessa posição.
+    bool download_file(const std::string& remote_file, const std::string& local_file,
+                       uint64_t offset = 0) {
+        // Abrir o arquivo antes do RETR para não iniciar uma transferência inútil
+        int flags = O_WRONLY | O_CREAT | O_CLOEXEC | (offset == 0 ? O_TRUNC : 0);
+        int file_fd = open(local_file.c_str(), flags, 0644);
+        if (file_fd < 0 || (offset > 0 && (ftruncate(file_fd, offset) < 0 ||
+                                           lseek(file_fd, offset, SEEK_SET) < 0))) {
+            std::cerr << "Erro ao criar arquivo local: " << local_file << std::endl;
+            if (file_fd >= 0) {
+                close(file_fd);
+            }
+            return false;
+        }
+
+        FTPReply response = start_transfer("RETR " + remote_file, true, offset);
+        if (!response.preliminary()) {
+            std::cerr << "Erro no RETR: " << response << std::endl;
+            close(file_fd);
+            // Um arquivo parcial é mantido para um resume posterior
+            if (offset == 0) {
+                unlink(local_file.c_str());
+            }
+            return false;
+        }
+
+        // Receber dados do arquivo direto para o disco. O tamanho no 150 é o
+        // do arquivo inteiro no servidor, então só serve de verificação sem
+        // REST e em TYPE I (em TYPE A a conversão de CRLF muda a contagem).
+        uint64_t expected = offset == 0 && transfer_type == TransferType::BINARY
+                                ? parse_size_hint(response) : 0;
+        bool ok = stream_to_file(data_socket.fd(), file_fd, expected);
+        data_socket.reset();
+
+        if (close(file_fd) < 0) {
+            ok = false;
+        }
+
+        // Ler resposta final
+        response = finish_transfer();
+        if (!ok || response.code != 226) {
+            std::cerr << "Erro no download de " << remote_file << ": " << response << std::endl;
+            return false;
+        }
+
+        if (verbose) {
+            std::cout << "Download concluído: " << remote_file << " -> " << local_file << std::endl;
+        }
+        return true;
+    }
+
+    // Continua um download parcial: compara o tamanho local com o SIZE remoto
+    // e pede só o que falta. Arquivo local já completo não gera transferência.
+    bool resume_file(const std::string& remote_file, const std::string& local_file) {
+        struct stat info{};
+        if (stat(local_file.c_str(), &info) < 0 || info.st_size == 0) {
+            return download_file(remote_file, local_file);
+        }
+
+        int64_t size = get_size(remote_file);
+        if (size < 0 || info.st_size > size) {
+            return download_file(remote_file, local_file);
+        }
+        if (info.st_size == size) {
+            last_transfer = TransferStats();
+            return true;
+        }
+        return download_file(remote_file, local_file, info.st_size);
+    }
+
+    // NLST: apenas os nomes, um por linha
+    std::vector<std::string> name_list(const std::string& path = "") {
+        std::vector<std::string> names;
+        FTPReply response = start_transfer(path.empty() ? "NLST" : "NLST " + path, false);
+        if (!response.preliminary()) {
+            // 450/550: diretório vazio ou inexistente
+            return names;
+        }
+
+        std::string data = read_data();
+        data_socket.reset();
+        finish_transfer();
+
+        std::stringstream lines(data);
+        std::string name;
+        while (std::getline(lines, name)) {
+            if (!name.empty() && name.back() == '\r') {
+                name.pop_back();
+            }
+            if (!name.empty()) {
+                names.push_back(name);
+            }
+        }
+        return names;
+    }
+
+    // MLSD (RFC 3659): entradas estruturadas do diretório, guardadas no cache
+    // da sessão até um STOR/DELE nele ou invalidate_directory()
+    std::vector<FTPEntry> list_entries(const std::string& path = "", bool use_cache = true) {
+        if (use_cache) {
+            auto cached = directory_cache.find(normalize_path(path));
+            if (cached != directory_cache.end()) {
+                return cached->second;
+            }
+        }
+
+        std::vector<FTPEntry> entries;
+        FTPReply response = start_transfer(path.empty() ? "MLSD" : "MLSD " + path, false);
+        if (!response.preliminary()) {
+            std::cerr << "Erro no MLSD: " << response << std::endl;
+            return entries;
+        }
+
+        std::string data = read_data();
+        data_socket.reset();
+        response = finish_transfer();
+        if (response.code != 226) {
+            std::cerr << "Erro no MLSD: " << response << std::endl;
+            return entries;
+        }
+
+        std::stringstream lines(data);
+        std::string line;
+        while (std::getline(lines, line)) {
+            FTPEntry entry;
+            // Entradas do próprio diretório e do pai não interessam
+            if (FTPEntry::parse(line, entry) && entry.type != "cdir" && entry.type != "pdir") {
+                entries.push_back(std::move(entry));
+            }
+        }
+
+        directory_cache[normalize_path(path)] = entries;
+        return entries;
+    }
+
+    // MLST: fatos de um único caminho pelo canal de controle
+    bool stat_entry(const std::string& path, FTPEntry& entry) {
+        if (cached_entry(path, entry)) {
+            return true;
+        }
+
+        FTPReply response = send_command("MLST " + path);
+        // "250-Listing x", " type=file;size=1; x", "250 End"
+        if (response.code != 250 || response.lines.size() < 3) {
+            return false;
+        }
+        return FTPEntry::parse(response.lines[1], entry);
+    }
+
+    void invalidate_directory(const std::string& path) {
+        directory_cache.erase(normalize_path(path));
+    }
+
+    void clear_directory_cache() {
+        directory_cache.clear();
+    }
+
+    // Código da última resposta do servidor (0 se a conexão caiu)
+    int last_reply_code() const {
+        return last_code;
+    }
+
+    const std::string& server_name() const { return server; }
+    int server_port() const { return port; }
+    const std::string& user_name() const { return username; }
+    const std::string& user_password() const { return password; }
+
+    bool is_connected() const {
+        return control_socket.valid();
+    }
+
+    // Tamanho remoto via SIZE (RFC 3659); -1 se não suportado
+    int64_t get_size(const std::string& remote_file) {
+        // Diretório já listado via MLSD: sem round-trip
+        FTPEntry entry;
+        if (cached_entry(remote_file, entry) && entry.size >= 0) {
+            return entry.size;
+        }
+
+        // SIZE só tem valor exato em TYPE I; o tipo escolhido pelo usuário é
+        // restaurado e o próximo RETR/STOR volta a negociá-lo.
+        TransferType previous = transfer_type;
+        if (!set_transfer_type(TransferType::BINARY)) {
+            return -1;
+        }
+        FTPReply response = send_command("SIZE " + remote_file);
+        if (previous != TransferType::BINARY) {
+            transfer_type = previous;
+            type_negotiated = false;
+        }
+        if (response.code != 213 || response.lines[0].size() < 5) {
+            return -1;
+        }
+        return std::strtoll(response.lines[0].c_str() + 4, nullptr, 10);
+    }
+
+    // Download em N segmentos paralelos: cada segmento abre sua própria sessão
+    // (controle + dados), posiciona com REST e grava com pwrite num arquivo
+    // pré-alocado. Sem SIZE/REST, ou para arquivos pequenos, cai no RETR simples.
+    static constexpr uint64_t MIN_SEGMENT_SIZE = 1024 * 1024;
+
+    bool download_segmented(const std::string& remote_file, const std::string& local_file,
+                            unsigned segments) {
+        int64_t size = get_size(remote_file);
+        if (size < 0 || segments < 2 || static_cast<uint64_t>(size) < 2 * MIN_SEGMENT_SIZE) {
+            return download_file(remote_file, local_file);
+        }
+        segments = std::min<uint64_t>(segments, size / MIN_SEGMENT_SIZE);
+
+        int file_fd = open(local_file.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+        if (file_fd < 0) {
+            std::cerr << "Erro ao criar arquivo local: " << local_file << std::endl;
+            return false;
+        }
+        // Reservar o espaço de uma vez evita fragmentação e ENOSPC no meio
+        if (posix_fallocate(file_fd, 0, size) != 0 && ftruncate(file_fd, size) < 0) {
+            std::cerr << "Erro ao alocar " << size << " bytes em " << local_file << std::endl;
+            close(file_fd);
+            return false;
+        }
+
+        std::atomic<uint64_t> transferred{0};
+        std::vector<char> results(segments, 0);
+        unsigned finished = 0;
+        std::mutex mutex;
+        std::condition_variable done;
+        std::vector<std::thread> workers;
+        auto start = std::chrono::steady_clock::now();
+
+        uint64_t segment_size = size / segments;
+        for (unsigned i = 0; i < segments; i++) {
+            uint64_t offset = i * segment_size;
+            uint64_t length = i + 1 == segments ? size - offset : segment_size;
+            workers.emplace_back([&, i, offset, length] {
+                char result = fetch_segment(remote_file, file_fd, offset, length, transferred);
+                std::lock_guard<std::mutex> lock(mutex);
+                results[i] = result;
+                finished++;
+                done.notify_one();
+            });
+        }
+
+        // Progresso agregado enquanto os segmentos trabalham
+        auto report = [&] {
+            last_transfer.bytes = transferred.load();
+            last_transfer.seconds = std::chrono::duration<double>(
+                std::chrono::steady_clock::now() - start).count();
+            if (progress_callback) {
+                progress_callback(last_transfer.bytes, size, last_transfer.bytes_per_second());
+            }
+        };
+        {
+            std::unique_lock<std::mutex> lock(mutex);
+            while (!done.wait_for(lock, std::chrono::milliseconds(200),
+                                  [&] { return finished == segments; })) {
+                report();
+            }
+        }
+        for (auto& worker : workers) {
+            worker.join();
+        }
+        report();
+
+        bool ok = std::count(results.begin(), results.end(), 1) == static_cast<long>(segments);
+        if (close(file_fd) < 0) {
+            ok = false;
+        }
+        if (!ok) {
+            std::cerr << "Erro no download segmentado de " << remote_file << std::endl;
+            unlink(local_file.c_str());
+            return false;
+        }
+
+        if (verbose) {
+            std::cout << "Download concluído: " << remote_file << " -> " << local_file
+                      << " (" << segments << " segmentos)" << std::endl;
+        }
+        return true;
+    }
+
+    // STOR enviando direto do descritor do arquivo (sendfile no Linux)
+    bool upload_file(const std::string& local_file, const std::string& remote_file) {
+        int file_fd = open(local_file.c_str(), O_RDONLY | O_CLOEXEC);
+        struct stat info{};
+        if (file_fd < 0 || fstat(file_fd, &info) < 0) {
+            std::cerr << "Erro ao abrir arquivo local: " << local_file << std::endl;
+            if (file_fd >= 0) {
+                close(file_fd);
+            }
+            return false;
+        }
+
+        FTPReply response = start_transfer("STOR " + remote_file, true);
+        if (!response.preliminary()) {
+            std::cerr << "Erro no STOR: " << response << std::endl;
+            close(file_fd);
+            return false;
+        }
+
+        // O diretório mudou mesmo que o envio falhe no meio
+        invalidate_directory(parent_directory(remote_file));
+
+        // Enviar dados; fechar o socket sinaliza o fim do arquivo ao servidor
+        bool ok = stream_from_file(file_fd, data_socket.fd(), info.st_size);
+        close(file_fd);
+        data_socket.reset();
+
+        // Ler resposta final
+        response = finish_transfer();
+        if (!ok || response.code != 226) {
+            std::cerr << "Erro no upload de " << local_file << ": " << response << std::endl;
+            return false;
+        }
+
+        if (verbose) {
+            std::cout << "Upload concluído: " << local_file << " -> " << remote_file << std::endl;
+        }
+        return true;
+    }
+
+private:
+    // Chave do cache de diretórios: "dir/", "dir//" e "./dir" viram "dir"
+    static std::string normalize_path(const std::string& path) {
+        std::string normalized = !path.empty() && path[0] == '/' ? "/" : "";
+        std::stringstream segments(path);
+        std::string segment;
+        while (std::getline(segments, segment, '/')) {
+            if (segment.empty() || segment == ".") {
+                continue;
+            }
+            if (!normalized.empty() && normalized.back() != '/') {
+                normalized += '/';
+            }
+            normalized += segment;
+        }
+        return normalized;
+    }
+
+    static std::string parent_directory(const std::string& path) {
+        size_t slash = path.rfind('/');
+        if (slash == std::string::npos) {
+            return "";
+        }
+        return slash == 0 ? "/" : path.substr(0, slash);
+    }
+
+    bool cached_entry(const std::string& remote_path, FTPEntry& entry) const {
+        std::string path = normalize_path(remote_path);
+        auto cached = directory_cache.find(parent_directory(path));
+        if (cached == directory_cache.end()) {
+            return false;
+        }
+        std::string name = path.substr(path.rfind('/') + 1);
+        for (const FTPEntry& candidate : cached->second) {
+            if (candidate.name == name) {
+                entry = candidate;
+                return true;
+            }
+        }
+        return false;
+    }
+
+    // --- Canal de dados ---
+
+    const char* passive_command() const {
+        return epsv_supported ? "EPSV" : "PASV";
+    }
+
+    // Interpreta 229 (EPSV) ou 227 (PASV) e inicia um connect não bloqueante.
+    // Um EPSV recusado com 5xx desliga o EPSV para esta sessão.
+    bool open_passive(const FTPReply& response) {
+        if (response.code == 229) {
+            // "229 Entering Extended Passive Mode (|||6446|)": mesmo host do controle
+            const std::string& text = response.lines.back();
+            size_t start = text.find('(');
+            if (start == std::string::npos || start + 4 >= text.size()) {
+                std::cerr << "Resposta EPSV malformada" << std::endl;
+                return false;
+            }
+            char delimiter = text[start + 1];
+            size_t port_start = start + 4;
+            size_t port_end = text.find(delimiter, port_start);
+            if (text[start + 2] != delimiter || text[start + 3] != delimiter ||
+                port_end == std::string::npos) {
+                std::cerr << "Resposta EPSV malformada" << std::endl;
+                return false;
+            }
+            int data_port = std::atoi(text.substr(port_start, port_end - port_start).c_str());
+
+            struct sockaddr_storage peer{};
+            socklen_t length = sizeof(peer);
+            if (getpeername(control_socket.fd(), (struct sockaddr*)&peer, &length) < 0 ||
+                data_port <= 0 || data_port > 65535) {
+                return false;
+            }
+            if (peer.ss_family == AF_INET6) {
+                ((struct sockaddr_in6*)&peer)->sin6_port = htons(data_port);
+            } else {
+                ((struct sockaddr_in*)&peer)->sin_port = htons(data_port);
+            }
+            return begin_data_connect(peer, length);
+        }
+
+        if (response.code != 227) {
+            if (epsv_supported && response.permanent()) {
+                epsv_supported = false;
+            }
             return false;
         }
 
         // Parse da resposta PASV para obter IP e porta
-        size_t start = response.find('(');
-        size_t end = response.find(')');
+        const std::string& text = response.lines.back();
+        size_t start = text.find('(');
+        size_t end = text.find(')', start);
         if (start == std::string::npos || end == std::string::npos) {
             std::cerr << "Resposta PASV malformada" << std::endl;
             return false;
         }
 
-        std::string pasv_data = response.substr(start + 1, end - start - 1);
+        std::string pasv_data = text.substr(start + 1, end - start - 1);
         std::vector<int> numbers;
         std::stringstream ss(pasv_data);
         std::string item;
 
         while (std::getline(ss, item, ',')) {
-            numbers.push_back(std::stoi(item));
+            numbers.push_back(std::atoi(item.c_str()));
         }
 
         if (numbers.size() != 6) {
@@ -167,165 +877,841 @@ public:
                              std::to_string(numbers[3]);
         int data_port = (numbers[4] << 8) + numbers[5];
 
-        // Conectar socket de dados
-        data_socket = socket(AF_INET, SOCK_STREAM, 0);
-        if (data_socket < 0) {
+        struct sockaddr_storage address{};
+        struct sockaddr_in* data_addr = (struct sockaddr_in*)&address;
+        data_addr->sin_family = AF_INET;
+        data_addr->sin_port = htons(data_port);
+        if (inet_pton(AF_INET, data_ip.c_str(), &data_addr->sin_addr) != 1) {
+            return false;
+        }
+        return begin_data_connect(address, sizeof(struct sockaddr_in));
+    }
+
+    bool begin_data_connect(const struct sockaddr_storage& address, socklen_t length) {
+        data_socket.reset(socket(address.ss_family, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0));
+        if (!data_socket) {
             std::cerr << "Erro ao criar socket de dados" << std::endl;
             return false;
         }
+        // SO_RCVBUF antes do connect: define a window scale anunciada no SYN
+        apply_tuning(data_socket.fd(), tuning);
+        if (::connect(data_socket.fd(), (const struct sockaddr*)&address, length) < 0 &&
+            errno != EINPROGRESS) {
+            std::cerr << "Erro ao conectar socket de dados" << std::endl;
+            data_socket.reset();
+            return false;
+        }
+        return true;
+    }
 
-        struct sockaddr_in data_addr{};
-        data_addr.sin_family = AF_INET;
-        data_addr.sin_port = htons(data_port);
-        inet_pton(AF_INET, data_ip.c_str(), &data_addr.sin_addr);
+    // Espera o connect terminar e devolve o socket ao modo bloqueante
+    bool finish_data_connect() {
+        if (!data_socket) {
+            return false;
+        }
 
-        if (::connect(data_socket, (struct sockaddr*)&data_addr, sizeof(data_addr)) < 0) {
+        struct pollfd pfd{data_socket.fd(), POLLOUT, 0};
+        int error = 0;
+        socklen_t length = sizeof(error);
+        int ready;
+        while ((ready = poll(&pfd, 1, DATA_CONNECT_TIMEOUT_MS)) < 0 && errno == EINTR) {
+        }
+        if (ready <= 0 || getsockopt(data_socket.fd(), SOL_SOCKET, SO_ERROR, &error, &length) < 0 ||
+            error != 0) {
             std::cerr << "Erro ao conectar socket de dados" << std::endl;
-            close(data_socket);
-            data_socket = -1;
+            data_socket.reset();
             return false;
         }
 
-        passive_mode = true;
+        fcntl(data_socket.fd(), F_SETFL, fcntl(data_socket.fd(), F_GETFL) & ~O_NONBLOCK);
+        transfer_trace.mark(TracePhase::CONNECT);
         return true;
     }
 
-    std::string list_files() {
-        if (!set_passive_mode()) {
-            return "";
+    void discard_data_connection() {
+        data_socket.reset();
+        data_ready = false;
+    }
+
+    // Prepara o canal de dados e envia o comando de transferência (com TYPE e
+    // REST quando preciso). Retorna a resposta preliminar (1xx) ou o erro.
+    // No modo pipelined tudo vai num único write, junto com o EPSV/PASV da
+    // próxima transferência (o servidor o processa ao fim desta); as
+    // respostas são lidas em ordem e o connect de dados corre em paralelo.
+    FTPReply start_transfer(const std::string& command, bool needs_type, uint64_t offset = 0) {
+        FTPReply failure;
+        transfer_trace.begin();
+        if (PhaseTrace::ENABLED) {
+            transfer_command = command.substr(0, command.find(' '));
         }
 
-        std::string response = send_command("LIST");
-        if (response.substr(0, 3) != "150") {
-            std::cerr << "Erro no LIST: " << response << std::endl;
-            return "";
+        if (!pipelining) {
+            if ((needs_type && !set_transfer_type(transfer_type)) || !set_passive_mode()) {
+                failure.code = last_code;
+                failure.lines.push_back("Falha ao preparar a transferência");
+                return failure;
+            }
+            if (offset > 0) {
+                FTPReply response = send_command("REST " + std::to_string(offset));
+                if (response.code != 350) {
+                    discard_data_connection();
+                    return response;
+                }
+            }
+            FTPReply response = send_command(command, &transfer_trace);
+            if (!response.preliminary()) {
+                discard_data_connection();
+            }
+            return response;
         }
 
-        // Ler dados do socket de dados
-        std::string file_list = read_data();
-        close(data_socket);
-        data_socket = -1;
+        bool send_type = needs_type && !type_negotiated;
+        bool prepared = data_ready;
+        bool extended = epsv_supported;
+        data_ready = false;
 
-        // Ler resposta final
-        read_response();
+        std::string batch;
+        if (send_type) {
+            batch += transfer_type == TransferType::BINARY ? "TYPE I\r\n" : "TYPE A\r\n";
+        }
+        if (!prepared) {
+            batch += std::string(passive_command()) + "\r\n";
+        }
+        if (offset > 0) {
+            batch += "REST " + std::to_string(offset) + "\r\n";
+        }
+        batch += command + "\r\n";
+        batch += std::string(passive_command()) + "\r\n";
+        if (!send_all(control_socket.fd(), batch.data(), batch.size())) {
+            discard_data_connection();
+            return failure;
+        }
+        transfer_trace.mark(TracePhase::WRITE);
+
+        // As respostas chegam na ordem dos comandos; a primeira falha é a que vale
+        if (send_type) {
+            FTPReply response = read_response();
+            type_negotiated = response.code == 200;
+            if (!type_negotiated && failure.lines.empty()) {
+                failure = response;
+            }
+        }
+        if (!prepared) {
+            FTPReply response = read_response();
+            if (!(open_passive(response) && finish_data_connect()) && failure.lines.empty()) {
+                failure = response;
+            }
+        }
+        if (offset > 0) {
+            FTPReply response = read_response();
+            if (response.code != 350 && failure.lines.empty()) {
+                failure = response;
+            }
+        }
+        FTPReply response = read_response();
+        transfer_trace.mark(TracePhase::FIRST_BYTE);
+        prefetch_pending = true;
+
+        if (!failure.lines.empty() || !response.preliminary()) {
+            discard_data_connection();
+            // O comando pode ter chegado a abrir a transferência mesmo assim
+            if (response.preliminary()) {
+                read_response();
+            }
+            read_prefetch();
+            FTPReply& result = failure.lines.empty() ? response : failure;
+            last_code = result.code;
+            // Canal pré-aberto expirado ou EPSV recusado: repetir sem atalhos
+            bool retry = is_connected() && ((prepared && response.code == 425) ||
+                                            (extended && !epsv_supported));
+            if (retry) {
+                return start_transfer(command, needs_type, offset);
+            }
+            return result;
+        }
+        return response;
+    }
 
-        return file_list;
+    // Lê a resposta final da transferência e, no modo pipelined, a do
+    // EPSV/PASV antecipado, deixando o canal da próxima já conectado
+    FTPReply finish_transfer() {
+        FTPReply response = read_response();
+        transfer_trace.mark(TracePhase::TRANSFER);
+        last_transfer.trace = transfer_trace;
+        if (trace_output && trace_output->enabled()) {
+            trace_output->record(transfer_trace, {{"command", transfer_command},
+                                                  {"server", server},
+                                                  {"code", std::to_string(response.code)}});
+        }
+        read_prefetch();
+        // last_reply_code() deve refletir a transferência, não o EPSV antecipado
+        last_code = response.code;
+        return response;
     }
 
-    bool download_file(const std::string& remote_file, const std::string& local_file) {
-        if (!set_passive_mode()) {
-            return false;
+    void read_prefetch() {
+        if (prefetch_pending) {
+            prefetch_pending = false;
+            if (is_connected()) {
+                data_ready = open_passive(read_response()) && finish_data_connect();
+            }
         }
+    }
 
-        std::string response = send_command("RETR " + remote_file);
-        if (response.substr(0, 3) != "150") {
-            std::cerr << "Erro no RETR: " << response << std::endl;
-            return false;
+    // Próxima linha do canal de controle (sem CRLF). Bytes que chegam além
+    // dela ficam em control_buffer para a leitura seguinte.
+    bool read_line(std::string& line) {
+        size_t newline;
+        while ((newline = control_buffer.view().find('\n', control_scanned)) == std::string_view::npos) {
+            control_scanned = control_buffer.size();
+            if (control_buffer.size() > MAX_CONTROL_LINE) {
+                std::cerr << "Linha de controle longa demais" << std::endl;
+                return false;
+            }
+
+            // recv direto no espaço livre do buffer
+            if (control_buffer.fill(control_socket.fd()) <= 0) {
+                return false;
+            }
         }
 
-        // Receber dados do arquivo
-        std::string file_data = read_data();
-        close(data_socket);
-        data_socket = -1;
+        const char* text = control_buffer.data();
+        size_t end = newline > 0 && text[newline - 1] == '\r' ? newline - 1 : newline;
+        line.assign(text, end);
+        control_buffer.consume(newline + 1);
+        control_scanned = 0;
+        return true;
+    }
 
-        // Salvar arquivo localmente
-        std::ofstream file(local_file, std::ios::binary);
-        if (!file) {
-            std::cerr << "Erro ao criar arquivo local: " << local_file << std::endl;
-            return false;
+    // Resposta completa (RFC 959 4.2): "ddd texto" ou um bloco "ddd-" ... "ddd texto".
+    // Linhas intermediárias de um bloco podem ter qualquer conteúdo.
+    FTPReply read_response() {
+        FTPReply reply;
+        std::string line;
+        bool complete = false;
+
+        while (!complete && read_line(line)) {
+            bool numbered = line.size() >= 3 && isdigit(static_cast<unsigned char>(line[0])) &&
+                            isdigit(static_cast<unsigned char>(line[1])) &&
+                            isdigit(static_cast<unsigned char>(line[2]));
+            if (reply.lines.empty()) {
+                if (!numbered) {
+                    // Lixo antes de uma resposta: ignorar
+                    continue;
+                }
+                reply.code = std::atoi(line.substr(0, 3).c_str());
+                reply.lines.push_back(line);
+                complete = line.size() == 3 || line[3] != '-';
+                continue;
+            }
+
+            reply.lines.push_back(line);
+            complete = numbered && std::atoi(line.substr(0, 3).c_str()) == reply.code &&
+                       (line.size() == 3 || line[3] == ' ');
+        }
+
+        // Conexão encerrada no meio (ou antes) da resposta
+        if (!complete) {
+            reply.code = 0;
         }
 
-        file.write(file_data.c_str(), file_data.size());
-        file.close();
+        last_code = reply.code;
+        if (reply.code == 0 || reply.code == 421) {
+            // Servidor encerrou a sessão
+            control_socket.reset();
+            control_buffer.clear();
+            control_scanned = 0;
+        }
 
-        // Ler resposta final
-        read_response();
+        return reply;
+    }
 
-        std::cout << "Download concluído: " << remote_file << " -> " << local_file << std::endl;
-        return true;
+    // Listagem inteira até o EOF, lida direto na string de retorno
+    std::string read_data() {
+        std::string data;
+        size_t calls = 0;
+        recv_to_end(data_socket.fd(), data, 64 * 1024, &calls);
+        transfer_trace.count_read(data.size(), calls);
+        return data;
     }
 
-    bool upload_file(const std::string& local_file, const std::string& remote_file) {
-        if (!set_passive_mode()) {
-            return false;
+    // Um segmento: sessão própria, REST offset + RETR, lê `length` bytes e
+    // abandona a transferência (ABOR implícito ao fechar o socket de dados).
+    // Retorna 1 em sucesso e -1 em falha.
+    char fetch_segment(const std::string& remote_file, int file_fd, uint64_t offset,
+                       uint64_t length, std::atomic<uint64_t>& transferred) {
+        FTPClient session;
+        session.set_verbose(false);
+        session.set_socket_tuning(tuning);
+        if (!session.connect(server, port) || !session.login(username, password) ||
+            !session.set_transfer_type(TransferType::BINARY) || !session.set_passive_mode()) {
+            return -1;
         }
 
-        // Ler arquivo local
-        std::ifstream file(local_file, std::ios::binary);
-        if (!file) {
-            std::cerr << "Erro ao abrir arquivo local: " << local_file << std::endl;
-            return false;
+        FTPReply response = session.send_command("REST " + std::to_string(offset));
+        if (response.code != 350) {
+            std::cerr << "Servidor não suporta REST: " << response << std::endl;
+            return -1;
+        }
+        response = session.send_command("RETR " + remote_file);
+        if (!response.preliminary()) {
+            std::cerr << "Erro no RETR: " << response << std::endl;
+            return -1;
         }
 
-        std::string file_data((std::istreambuf_iterator<char>(file)),
-                             std::istreambuf_iterator<char>());
-        file.close();
+        BufferPool::Lease buffer = BufferPool::shared().acquire(TRANSFER_CHUNK);
+        uint64_t received = 0;
+        while (received < length) {
+            ssize_t n = recv_some(session.data_socket.fd(), buffer.data(),
+                                  std::min<uint64_t>(buffer.size(), length - received));
+            if (n <= 0) {
+                break;
+            }
+            ssize_t written = 0;
+            while (written < n) {
+                ssize_t w = pwrite(file_fd, buffer.data() + written, n - written,
+                                   offset + received + written);
+                if (w < 0 && errno == EINTR) {
+                    continue;
+                }
+                if (w <= 0) {
+                    std::cerr << "Erro ao gravar arquivo: " << strerror(errno) << std::endl;
+                    return -1;
+                }
+                written += w;
+            }
+            received += n;
+            transferred += n;
+        }
 
-        std::string response = send_command("STOR " + remote_file);
-        if (response.substr(0, 3) != "150") {
-            std::cerr << "Erro no STOR: " << response << std::endl;
-            return false;
+        // Segmentos intermediários encerram antes do fim do arquivo; o servidor
+        // responde 426/451 (ou 226 se já tinha terminado), o que é esperado aqui
+        session.data_socket.reset();
+        session.read_response();
+        return received == length ? 1 : -1;
+    }
+
+    // "150 Opening BINARY mode data connection for arq (1234 bytes)"
+    static uint64_t parse_size_hint(const FTPReply& reply) {
+        const std::string& response = reply.lines.back();
+        size_t end = response.find(" bytes)");
+        if (end == std::string::npos) {
+            return 0;
+        }
+        size_t start = response.rfind('(', end);
+        if (start == std::string::npos) {
+            return 0;
         }
+        return std::strtoull(response.c_str() + start + 1, nullptr, 10);
+    }
 
-        // Enviar dados
-        send(data_socket, file_data.c_str(), file_data.size(), 0);
-        close(data_socket);
-        data_socket = -1;
+    // Copia socket -> arquivo até EOF. No Linux usa splice (socket -> pipe ->
+    // arquivo) sem passar os dados pelo espaço do usuário; caso contrário, ou
+    // se o sistema de arquivos não suportar splice, usa um buffer fixo.
+    // total: bytes esperados na conexão (0 = desconhecido, como em TYPE A).
+    bool stream_to_file(int sock, int file_fd, uint64_t total) {
+        auto start = std::chrono::steady_clock::now();
+        auto last_report = start;
+        last_transfer = TransferStats();
+
+        auto report = [&](bool force) {
+            auto now = std::chrono::steady_clock::now();
+            last_transfer.seconds = std::chrono::duration<double>(now - start).count();
+            if (progress_callback &&
+                (force || now - last_report >= std::chrono::milliseconds(200))) {
+                last_report = now;
+                progress_callback(last_transfer.bytes, total, last_transfer.bytes_per_second());
+            }
+        };
+
+        bool use_buffer = true;
+#ifdef __linux__
+        int pipe_fds[2];
+        if (pipe2(pipe_fds, O_CLOEXEC) == 0) {
+            use_buffer = false;
+            while (true) {
+                ssize_t in = splice(sock, nullptr, pipe_fds[1], nullptr, TRANSFER_CHUNK,
+                                    SPLICE_F_MOVE | SPLICE_F_MORE);
+                transfer_trace.count_read(std::max<ssize_t>(in, 0));
+                if (in < 0 && errno == EINTR) {
+                    continue;
+                }
+                if (in <= 0) {
+                    if (in < 0) {
+                        std::cerr << "Erro ao receber dados: " << strerror(errno) << std::endl;
+                    }
+                    break;
+                }
+
+                // Esvaziar o pipe no arquivo
+                ssize_t pending = in;
+                while (pending > 0) {
+                    ssize_t out = splice(pipe_fds[0], nullptr, file_fd, nullptr, pending,
+                                         SPLICE_F_MOVE | SPLICE_F_MORE);
+                    if (out < 0 && errno == EINTR) {
+                        continue;
+                    }
+                    if (out <= 0) {
+                        // Sem splice para o destino: o que está no pipe vai por read/write
+                        if (last_transfer.bytes == 0 && out < 0 && errno == EINVAL &&
+                            drain_pipe(pipe_fds[0], file_fd, pending)) {
+                            last_transfer.bytes += pending;
+                            use_buffer = true;
+                        } else {
+                            std::cerr << "Erro ao gravar arquivo: " << strerror(errno) << std::endl;
+                        }
+                        pending = -1;
+                        break;
+                    }
+                    pending -= out;
+                    last_transfer.bytes += out;
+                }
+                if (pending < 0) {
+                    break;
+                }
+                report(false);
+            }
+            close(pipe_fds[0]);
+            close(pipe_fds[1]);
 
-        // Ler resposta final
-        read_response();
+            if (!use_buffer) {
+                report(true);
+                return total == 0 || last_transfer.bytes == total;
+            }
+        }
+#endif
+
+        if (use_buffer) {
+            transfer_buffer.resize(TRANSFER_CHUNK);
+            while (true) {
+                ssize_t in = recv(sock, transfer_buffer.data(), transfer_buffer.size(), 0);
+                transfer_trace.count_read(std::max<ssize_t>(in, 0));
+                if (in < 0 && errno == EINTR) {
+                    continue;
+                }
+                if (in <= 0) {
+                    break;
+                }
+                if (!write_all(file_fd, transfer_buffer.data(), in)) {
+                    std::cerr << "Erro ao gravar arquivo: " << strerror(errno) << std::endl;
+                    return false;
+                }
+                last_transfer.bytes += in;
+                report(false);
+            }
+        }
 
-        std::cout << "Upload concluído: " << local_file << " -> " << remote_file << std::endl;
-        return true;
+        report(true);
+        return total == 0 || last_transfer.bytes == total;
     }
 
-private:
-    std::string read_response() {
-        char buffer[4096];
-        std::string response;
+    // Envia `total` bytes do arquivo pelo socket, tratando escritas parciais.
+    // Com limite de taxa, um token bucket (capacidade de ~1/10 s) dosa cada bloco.
+    bool stream_from_file(int file_fd, int sock, uint64_t total) {
+        auto start = std::chrono::steady_clock::now();
+        auto last_report = start;
+        auto last_refill = start;
+        double tokens = 0;
+        last_transfer = TransferStats();
+
+        bool use_sendfile = true;
+        off_t offset = 0;
+
+        while (last_transfer.bytes < total) {
+            size_t chunk = std::min<uint64_t>(total - last_transfer.bytes, TRANSFER_CHUNK);
+
+            if (rate_limit > 0) {
+                double burst = std::max<double>(rate_limit / 10.0, 1);
+                while (true) {
+                    auto now = std::chrono::steady_clock::now();
+                    tokens = std::min(burst, tokens + rate_limit *
+                        std::chrono::duration<double>(now - last_refill).count());
+                    last_refill = now;
+                    if (tokens >= 1) {
+                        break;
+                    }
+                    std::this_thread::sleep_for(std::chrono::duration<double>(
+                        (1 - tokens) / rate_limit));
+                }
+                chunk = std::min<size_t>(chunk, static_cast<size_t>(tokens));
+            }
 
-        while (true) {
-            ssize_t bytes_read = recv(control_socket, buffer, sizeof(buffer) - 1, 0);
-            if (bytes_read <= 0) {
-                break;
+            ssize_t sent = -1;
+#ifdef __linux__
+            if (use_sendfile) {
+                sent = sendfile(sock, file_fd, &offset, chunk);
+                transfer_trace.count_write(std::max<ssize_t>(sent, 0));
+                if (sent < 0 && (errno == EINVAL || errno == ENOSYS)) {
+                    // Origem sem suporte a sendfile: continuar com read/send
+                    use_sendfile = false;
+                    continue;
+                }
+            }
+#else
+            use_sendfile = false;
+#endif
+            if (!use_sendfile) {
+                transfer_buffer.resize(TRANSFER_CHUNK);
+                ssize_t n = pread(file_fd, transfer_buffer.data(), chunk, offset);
+                if (n < 0 && errno == EINTR) {
+                    continue;
+                }
+                if (n <= 0) {
+                    std::cerr << "Erro ao ler arquivo local" << std::endl;
+                    return false;
+                }
+                if (!send_all(sock, transfer_buffer.data(), n)) {
+                    std::cerr << "Erro ao enviar dados: " << strerror(errno) << std::endl;
+                    return false;
+                }
+                transfer_trace.count_write(n);
+                offset += n;
+                sent = n;
             }
 
-            buffer[bytes_read] = '\0';
-            response += buffer;
+            if (sent < 0 && errno == EINTR) {
+                continue;
+            }
+            if (sent <= 0) {
+                // 0 = arquivo encolheu durante o envio
+                std::cerr << "Erro ao enviar dados: "
+                          << (sent == 0 ? "fim inesperado do arquivo" : strerror(errno)) << std::endl;
+                return false;
+            }
 
-            // Resposta FTP termina com código de 3 dígitos + espaço
-            if (response.length() >= 4 && response[3] == ' ') {
-                break;
+            last_transfer.bytes += sent;
+            tokens -= sent;
+
+            auto now = std::chrono::steady_clock::now();
+            last_transfer.seconds = std::chrono::duration<double>(now - start).count();
+            if (progress_callback &&
+                (now - last_report >= std::chrono::milliseconds(200) || last_transfer.bytes == total)) {
+                last_report = now;
+                progress_callback(last_transfer.bytes, total, last_transfer.bytes_per_second());
             }
         }
 
+        last_transfer.seconds = std::chrono::duration<double>(
+            std::chrono::steady_clock::now() - start).count();
+        return true;
+    }
+
+    bool drain_pipe(int pipe_fd, int file_fd, size_t length) {
+        transfer_buffer.resize(TRANSFER_CHUNK);
+        while (length > 0) {
+            ssize_t n = read(pipe_fd, transfer_buffer.data(),
+                             std::min(length, transfer_buffer.size()));
+            if (n <= 0 || !write_all(file_fd, transfer_buffer.data(), n)) {
+                return false;
+            }
+            length -= n;
+        }
+        return true;
+    }
+
+    static bool write_all(int fd, const char* data, size_t length) {
+        while (length > 0) {
+            ssize_t n = write(fd, data, length);
+            if (n < 0 && errno == EINTR) {
+                continue;
+            }
+            if (n <= 0) {
+                return false;
+            }
+            data += n;
+            length -= n;
+        }
+        return true;
+    }
+
+    // Com trace, marca o fim do envio (write) e a chegada da resposta (first_byte)
+    FTPReply send_command(const std::string& command, PhaseTrace* trace = nullptr) {
+        std::string full_command = command + "\r\n";
+        // Falha no envio aparece como conexão encerrada em read_response
+        send_all(control_socket.fd(), full_command.data(), full_command.size());
+        if (trace) {
+            trace->mark(TracePhase::WRITE);
+        }
+        FTPReply response = read_response();
+        if (trace) {
+            trace->mark(TracePhase::FIRST_BYTE);
+        }
         return response;
     }
+};
 
-    std::string read_data() {
-        char buffer[4096];
-        std::string data;
+// --- Fila de transferências ---
 
-        while (true) {
-            ssize_t bytes_read = recv(data_socket, buffer, sizeof(buffer) - 1, 0);
-            if (bytes_read <= 0) {
-                break;
+// Distribui downloads entre um pool de sessões FTP já autenticadas. Cada
+// sessão tem sua própria fila e, quando ela esvazia, rouba trabalho do fim
+// da fila de outra sessão. Respostas 4xx (transitórias) geram nova tentativa
+// com espera crescente; reconexões retomam arquivos parciais via REST.
+class TransferQueue {
+public:
+    struct Summary {
+        size_t files = 0;
+        size_t failed = 0;
+        size_t retries = 0;
+        uint64_t bytes = 0;
+        double seconds = 0;
+
+        double bytes_per_second() const { return seconds > 0 ? bytes / seconds : 0; }
+    };
+
+    static constexpr int MAX_ATTEMPTS = 3;
+
+    TransferQueue(const std::string& server, int port, const std::string& username,
+                  const std::string& password, unsigned sessions = 4)
+        : server(server), port(port), username(username), password(password),
+          sessions(std::max(1u, sessions)) {}
+
+    void add(const std::string& remote_file, const std::string& local_file) {
+        pending.push_back({remote_file, local_file, 0});
+    }
+
+    // Expande um padrão (fnmatch) contra o NLST do diretório do padrão
+    size_t add_glob(FTPClient& client, const std::string& pattern, const std::string& local_dir) {
+        size_t slash = pattern.rfind('/');
+        std::string dir = slash == std::string::npos ? "" : pattern.substr(0, slash);
+        std::string name_pattern = slash == std::string::npos ? pattern : pattern.substr(slash + 1);
+
+        size_t added = 0;
+        for (const std::string& entry : client.name_list(dir)) {
+            // Alguns servidores devolvem o caminho completo no NLST
+            std::string name = entry.substr(entry.rfind('/') + 1);
+            if (fnmatch(name_pattern.c_str(), name.c_str(), 0) == 0) {
+                std::string remote = dir.empty() ? name : dir + "/" + name;
+                add(remote, local_dir.empty() ? name : local_dir + "/" + name);
+                added++;
             }
+        }
+        return added;
+    }
+
+    size_t size() const {
+        return pending.size();
+    }
+
+    void set_sessions(unsigned value) {
+        sessions = std::max(1u, value);
+    }
+
+    void set_pipelining(bool enabled) {
+        pipelining = enabled;
+    }
+
+    void set_socket_tuning(const SocketTuning& value) {
+        tuning = value;
+    }
+
+    Summary run() {
+        Summary summary;
+        auto start = std::chrono::steady_clock::now();
 
-            buffer[bytes_read] = '\0';
-            data += buffer;
+        unsigned count = std::min<size_t>(sessions, std::max<size_t>(pending.size(), 1));
+        queues = std::vector<WorkerQueue>(count);
+        for (size_t i = 0; i < pending.size(); i++) {
+            queues[i % count].items.push_back(pending[i]);
         }
+        pending.clear();
 
-        return data;
+        std::vector<Summary> partial(count);
+        std::vector<std::thread> workers;
+        for (unsigned i = 0; i < count; i++) {
+            workers.emplace_back([this, i, &partial] { work(i, partial[i]); });
+        }
+        for (auto& worker : workers) {
+            worker.join();
+        }
+
+        for (const Summary& part : partial) {
+            summary.files += part.files;
+            summary.failed += part.failed;
+            summary.retries += part.retries;
+            summary.bytes += part.bytes;
+        }
+        summary.seconds = std::chrono::duration<double>(
+            std::chrono::steady_clock::now() - start).count();
+        return summary;
     }
 
-    std::string send_command(const std::string& command) {
-        std::string full_command = command + "\r\n";
-        send(control_socket, full_command.c_str(), full_command.length(), 0);
-        return read_response();
+private:
+    struct Item {
+        std::string remote;
+        std::string local;
+        int attempts;
+    };
+
+    struct WorkerQueue {
+        std::mutex mutex;
+        std::deque<Item> items;
+    };
+
+    std::string server;
+    int port;
+    std::string username;
+    std::string password;
+    unsigned sessions;
+    bool pipelining = false;
+    SocketTuning tuning;
+    std::vector<Item> pending;
+    std::vector<WorkerQueue> queues;
+
+    // Próximo item: frente da própria fila, senão o fim de outra
+    bool next(unsigned self, Item& item) {
+        {
+            std::lock_guard<std::mutex> lock(queues[self].mutex);
+            if (!queues[self].items.empty()) {
+                item = std::move(queues[self].items.front());
+                queues[self].items.pop_front();
+                return true;
+            }
+        }
+        for (size_t k = 1; k < queues.size(); k++) {
+            WorkerQueue& victim = queues[(self + k) % queues.size()];
+            std::lock_guard<std::mutex> lock(victim.mutex);
+            if (!victim.items.empty()) {
+                item = std::move(victim.items.back());
+                victim.items.pop_back();
+                return true;
+            }
+        }
+        return false;
+    }
+
+    bool open_session(std::unique_ptr<FTPClient>& session) {
+        session.reset(new FTPClient());
+        session->set_verbose(false);
+        session->set_pipelining(pipelining);
+        session->set_socket_tuning(tuning);
+        return session->connect(server, port) && session->login(username, password);
+    }
+
+    void work(unsigned self, Summary& summary) {
+        std::unique_ptr<FTPClient> session;
+        Item item;
+
+        while (next(self, item)) {
+            bool ok = false;
+            while (!ok && item.attempts < MAX_ATTEMPTS) {
+                if (item.attempts > 0) {
+                    summary.retries++;
+                    std::this_thread::sleep_for(std::chrono::milliseconds(500 << item.attempts));
+                }
+                item.attempts++;
+
+                if (!session || !session->is_connected()) {
+                    if (!open_session(session)) {
+                        session.reset();
+                        continue;
+                    }
+                }
+
+                // Sempre via resume: uma tentativa anterior pode ter deixado um parcial
+                ok = session->resume_file(item.remote, item.local);
+                int code = session->last_reply_code();
+                if (!ok && session->is_connected() && (code < 400 || code >= 500)) {
+                    // Erro permanente (5xx) ou local: não adianta repetir
+                    break;
+                }
+            }
+
+            if (ok) {
+                summary.files++;
+                summary.bytes += session->last_transfer_stats().bytes;
+                std::cout << "OK " << item.remote << " -> " << item.local << std::endl;
+            } else {
+                summary.failed++;
+                std::cerr << "FALHOU " << item.remote << std::endl;
+            }
+        }
     }
 };
 
+// --- Benchmark de regressão binária ---
+
+// FNV-1a 64 bits, suficiente para detectar truncamento ou corrupção
+static uint64_t fnv1a_file(const std::string& path, uint64_t& length) {
+    uint64_t hash = 14695981039346656037ULL;
+    length = 0;
+
+    std::ifstream file(path, std::ios::binary);
+    char buffer[65536];
+    while (file.read(buffer, sizeof(buffer)) || file.gcount() > 0) {
+        std::streamsize n = file.gcount();
+        for (std::streamsize i = 0; i < n; i++) {
+            hash ^= static_cast<unsigned char>(buffer[i]);
+            hash *= 1099511628211ULL;
+        }
+        length += n;
+    }
+    return hash;
+}
+
+// Envia e baixa blobs aleatórios (com bytes NUL, CR e LF) e compara os checksums
+bool run_transfer_benchmark(FTPClient& client, const std::vector<size_t>& sizes) {
+    if (!client.set_transfer_type(FTPClient::TransferType::BINARY)) {
+        return false;
+    }
+
+    std::mt19937_64 rng(0x5eed);
+    std::string local = "/tmp/ftp_bench_" + std::to_string(getpid());
+    std::string copy = local + ".down";
+    bool all_ok = true;
+
+    std::cout << std::left << std::setw(12) << "bytes" << std::setw(10) << "status"
+              << std::setw(14) << "upload MB/s" << "download MB/s" << std::endl;
+
+    for (size_t size : sizes) {
+        {
+            std::ofstream out(local, std::ios::binary | std::ios::trunc);
+            std::vector<char> block(std::min<size_t>(size, 65536));
+            size_t remaining = size;
+            while (remaining > 0) {
+                size_t n = std::min(remaining, block.size());
+                for (size_t i = 0; i < n; i++) {
+                    block[i] = static_cast<char>(rng());
+                }
+                // Garantir os bytes que quebravam o caminho de texto
+                if (n >= 3) {
+                    block[0] = '\0';
+                    block[1] = '\r';
+                    block[2] = '\n';
+                }
+                out.write(block.data(), n);
+                remaining -= n;
+            }
+        }
+
+        std::string remote = "bench_" + std::to_string(size) + ".bin";
+        auto start = std::chrono::steady_clock::now();
+        bool ok = client.upload_file(local, remote);
+        double up_seconds = std::chrono::duration<double>(
+            std::chrono::steady_clock::now() - start).count();
+
+        ok = ok && client.download_file(remote, copy);
+        double down_seconds = client.last_transfer_stats().seconds;
+
+        uint64_t sent_length, received_length;
+        ok = ok && fnv1a_file(local, sent_length) == fnv1a_file(copy, received_length) &&
+             sent_length == received_length;
+        all_ok = all_ok && ok;
+
+        auto mbps = [size](double seconds) {
+            return seconds > 0 ? size / seconds / (1024 * 1024) : 0.0;
+        };
+        std::cout << std::left << std::setw(12) << size << std::setw(10) << (ok ? "OK" : "FALHOU")
+                  << std::setw(14) << std::fixed << std::setprecision(1) << mbps(up_seconds)
+                  << mbps(down_seconds) << std::endl;
+
+        client.delete_file(remote);
+    }
+
+    unlink(local.c_str());
+    unlink(copy.c_str());
+    return all_ok;
+}
+
 // ajuda
 void print_usage() {
     std::cout << "Uso: ftp_client <servidor> [porta]" << std::endl;
@@ -333,8 +1719,20 @@ void print_usage() {
     std::cout << "  user <username> - Definir usuário" << std::endl;
     std::cout << "  pass <password> - Definir senha" << std::endl;
     std::cout << "  list            - Listar arquivos" << std::endl;
+    std::cout << "  mls [dir]       - Listagem estruturada (MLSD, com cache)" << std::endl;
+    std::cout << "  mlst <caminho>  - Detalhes de um arquivo (MLST)" << std::endl;
+    std::cout << "  rm <arquivo>    - Remover arquivo remoto" << std::endl;
     std::cout << "  get <arquivo>   - Download" << std::endl;
+    std::cout << "  mget [-n sessões] <arquivo|padrão>... - Download em lote por um pool de sessões" << std::endl;
     std::cout << "  put <arquivo>   - Upload" << std::endl;
+    std::cout << "  pget <arquivo> [local] [n] - Download em n segmentos paralelos (padrão 4)" << std::endl;
+    std::cout << "  pipeline on|off - Enviar comandos sem esperar respostas e pré-abrir o canal de dados" << std::endl;
+    std::cout << "  limit <KB/s>    - Limitar taxa de upload (0 = sem limite)" << std::endl;
+    std::cout << "  rcvbuf <bytes>  - SO_RCVBUF das próximas conexões de dados (0 = padrão)" << std::endl;
+    std::cout << "  binary          - Transferências em modo binário (TYPE I, padrão)" << std::endl;
+    std::cout << "  ascii           - Transferências em modo texto (TYPE A)" << std::endl;
+    std::cout << "  bench [bytes..] - Upload/download de blobs binários com verificação" << std::endl;
+    std::cout << "  trace json|prometheus|off [arquivo] - Tempos por fase das transferências (padrão: stderr)" << std::endl;
     std::cout << "  quit            - Sair" << std::endl;
 }
 
@@ -348,6 +1746,20 @@ int main(int argc, char* argv[]) {
     int port = (argc > 2) ? std::stoi(argv[2]) : 21;
 
     FTPClient client;
+    std::unique_ptr<TraceWriter> trace_output;
+
+    // Progresso em linha única no stderr
+    client.set_progress_callback([](uint64_t transferred, uint64_t total, double rate) {
+        std::cerr << "\r" << transferred / 1024 << " KB";
+        if (total > 0) {
+            std::cerr << " / " << total / 1024 << " KB (" << transferred * 100 / total << "%)";
+        }
+        std::cerr << " - " << std::fixed << std::setprecision(1) << rate / (1024 * 1024)
+                  << " MB/s   " << std::flush;
+        if (total > 0 && transferred >= total) {
+            std::cerr << std::endl;
+        }
+    });
 
     if (!client.connect(server, port)) {
         return 1;
@@ -390,6 +1802,35 @@ int main(int argc, char* argv[]) {
             std::string files = client.list_files();
             std::cout << files << std::endl;
         }
+        else if (command == "mls" || command == "mlst") {
+            std::string path;
+            ss >> path;
+            std::vector<FTPEntry> entries;
+            FTPEntry entry;
+            if (command == "mls") {
+                entries = client.list_entries(path);
+            } else if (client.stat_entry(path, entry)) {
+                entries.push_back(entry);
+            } else {
+                std::cout << "Não encontrado: " << path << std::endl;
+            }
+            for (const FTPEntry& item : entries) {
+                char when[32] = "-";
+                if (item.modify_time) {
+                    strftime(when, sizeof(when), "%Y-%m-%d %H:%M:%S", gmtime(&item.modify_time));
+                }
+                std::cout << std::left << std::setw(6) << (item.is_directory() ? "dir" : item.type)
+                          << std::right << std::setw(12) << item.size << "  " << when << "  "
+                          << item.name << std::endl;
+            }
+        }
+        else if (command == "rm") {
+            std::string path;
+            ss >> path;
+            if (client.delete_file(path)) {
+                std::cout << "Removido: " << path << std::endl;
+            }
+        }
         else if (command == "get") {
             std::string remote_file, local_file;
             ss >> remote_file;
@@ -399,6 +1840,45 @@ int main(int argc, char* argv[]) {
                 client.download_file(remote_file, remote_file);
             }
         }
+        else if (command == "pget") {
+            std::string remote_file, local_file;
+            unsigned segments = 4;
+            ss >> remote_file;
+            if (!(ss >> local_file)) {
+                local_file = remote_file;
+            }
+            ss >> segments;
+            client.download_segmented(remote_file, local_file, segments);
+        }
+        else if (command == "mget") {
+            TransferQueue queue(client.server_name(), client.server_port(),
+                                client.user_name(), client.user_password());
+            queue.set_pipelining(client.get_pipelining());
+            queue.set_socket_tuning(client.get_socket_tuning());
+            std::string arg;
+            while (ss >> arg) {
+                if (arg == "-n") {
+                    unsigned sessions = 4;
+                    ss >> sessions;
+                    queue.set_sessions(sessions);
+                } else if (arg.find_first_of("*?[") != std::string::npos) {
+                    queue.add_glob(client, arg, "");
+                } else {
+                    queue.add(arg, arg.substr(arg.rfind('/') + 1));
+                }
+            }
+
+            if (queue.size() == 0) {
+                std::cout << "Nenhum arquivo para transferir" << std::endl;
+                continue;
+            }
+            TransferQueue::Summary summary = queue.run();
+            std::cout << summary.files << " arquivos, " << summary.failed << " falhas, "
+                      << summary.retries << " novas tentativas, " << summary.bytes / 1024 << " KB em "
+                      << std::fixed << std::setprecision(2) << summary.seconds << " s ("
+                      << std::setprecision(1) << summary.bytes_per_second() / (1024 * 1024)
+                      << " MB/s)" << std::endl;
+        }
         else if (command == "put") {
             std::string local_file, remote_file;
             ss >> local_file;
@@ -408,6 +1888,73 @@ int main(int argc, char* argv[]) {
                 client.upload_file(local_file, local_file);
             }
         }
+        else if (command == "pipeline") {
+            std::string mode;
+            ss >> mode;
+            client.set_pipelining(mode != "off");
+            std::cout << "Pipelining " << (mode != "off" ? "ativado" : "desativado") << std::endl;
+        }
+        else if (command == "rcvbuf") {
+            int bytes = 0;
+            ss >> bytes;
+            SocketTuning tuning = client.get_socket_tuning();
+            tuning.receive_buffer = std::max(0, bytes);
+            client.set_socket_tuning(tuning);
+            std::cout << "SO_RCVBUF das conexões de dados: "
+                      << (bytes > 0 ? std::to_string(bytes) + " bytes" : "padrão do kernel") << std::endl;
+        }
+        else if (command == "trace") {
+            std::string format, path;
+            ss >> format >> path;
+            // Trocar de destino fecha o anterior (o Prometheus é escrito ao fechar)
+            if (trace_output) {
+                trace_output->finish();
+                trace_output.reset();
+                client.set_trace_output(nullptr);
+            }
+            if (format == "off") {
+                std::cout << "Trace desativado" << std::endl;
+                continue;
+            }
+            auto output = std::make_unique<TraceWriter>();
+            std::string error;
+            if (!output->open(format, path, "ftp_client", error)) {
+                std::cout << error << std::endl;
+                continue;
+            }
+            // A conexão de controle já aberta entra como a primeira operação
+            output->record(client.connect_trace(), {{"command", "connect"},
+                                                    {"server", client.server_name()},
+                                                    {"code", "220"}});
+            trace_output = std::move(output);
+            client.set_trace_output(trace_output.get());
+            std::cout << "Trace " << format << " ativado" << std::endl;
+        }
+        else if (command == "limit") {
+            uint64_t kbps = 0;
+            ss >> kbps;
+            client.set_rate_limit(kbps * 1024);
+            std::cout << "Limite de upload: " << (kbps ? std::to_string(kbps) + " KB/s" : "nenhum")
+                      << std::endl;
+        }
+        else if (command == "binary" || command == "ascii") {
+            auto type = command == "binary" ? FTPClient::TransferType::BINARY
+                                            : FTPClient::TransferType::ASCII;
+            if (client.set_transfer_type(type)) {
+                std::cout << "Modo " << command << " ativado" << std::endl;
+            }
+        }
+        else if (command == "bench") {
+            std::vector<size_t> sizes;
+            size_t size;
+            while (ss >> size) {
+                sizes.push_back(size);
+            }
+            if (sizes.empty()) {
+                sizes = {0, 1, 4095, 65537, 1 << 20, 8 << 20};
+            }
+            run_transfer_benchmark(client, sizes);
+        }
         else {
             std::cout << "Comando desconhecido: " << command << std::endl;
             std::cout << "Use 'help' para ver comandos disponíveis" << std::endl;
@@ -415,6 +1962,9 @@ int main(int argc, char* argv[]) {
     }
 
     client.disconnect();
+    if (trace_output) {
+        trace_output->finish();
+    }
     std::cout << "Conexão encerrada." << std::endl;
 
     return 0;
@@ -3,13 +3,24 @@
  *
  * Objetivo: Aprendizagem do protocolo HTTP
  *
- * Compilar: g++ -std=c++17 -Wall http_client.cpp -o http_client
+ * Compilar: g++ -std=c++17 -Wall -pthread http_client.cpp -o http_client
+ * Com HTTPS: g++ -std=c++17 -Wall -pthread -DHTTP_WITH_TLS http_client.cpp -o http_client \
+ *                -lssl -lcrypto
+ * Com compressão (--compressed): -DHTTP_WITH_ZLIB (-lz) e/ou -DHTTP_WITH_BROTLI (-lbrotlidec)
+ * Com tempos por fase (--trace): -DPROTOCOLS_TRACE
  * Executar: ./http_client <URL> [método] [--data <dados>] [--headers <headers>]
  *
  * Exemplos:
  *   ./http_client http://httpbin.org/get
  *   ./http_client http://httpbin.org/post POST --data '{"teste": "dados"}'
  *   ./http_client http://httpbin.org/get --headers "Authorization: Bearer token"
+ *   ./http_client https://example.com/ --repeat 5 --no-reuse
+ *   ./http_client http://httpbin.org/gzip --compressed
+ *   ./http_client http://localhost:8080/dump.json --raw | jq .
+ *   ./http_client http://a.example/ http://b.example/ --parallel 32
+ *   ./http_client http://localhost:8080/ --repeat 100 --trace prometheus --trace-file m.prom
+ *   ./http_client http://localhost:8080/ --bench --concurrency 50 --duration 30 --output json
+ *   ./http_client --bench-parser 100000
  */
 
 #include <iostream>
@@ -17,299 +28,3285 @@
 #include <vector>
 #include <sstream>
 #include <cstring>
+#include <cstdlib>
+#include <cstdint>
+#include <cctype>
 #include <sys/socket.h>
 #include <netinet/in.h>
 #include <arpa/inet.h>
 #include <unistd.h>
 #include <netdb.h>
+#include <string_view>
+#include <charconv>
 #include <regex>
+#include <random>
 #include <map>
 #include <iomanip>
+#include <algorithm>
+#include <chrono>
+#include <deque>
+#include <cerrno>
+#include <poll.h>
+#include <functional>
+#include <memory>
+#include <set>
+#include <unordered_map>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <sys/uio.h>
+#include <sys/stat.h>
+#include <sys/sendfile.h>
+#include <fcntl.h>
+#include <climits>
+#include <csignal>
+#include <mutex>
+#include "../common/dns_resolver.h"
+#include "../common/latency_histogram.h"
+#include "../common/phase_trace.h"
+#include "../common/socket_io.h"
+
+#ifdef HTTP_WITH_TLS
+#include <openssl/err.h>
+#include <openssl/ssl.h>
+#endif
+#ifdef HTTP_WITH_ZLIB
+#include <zlib.h>
+#endif
+#ifdef HTTP_WITH_BROTLI
+#include <brotli/decode.h>
+#endif
+
+#ifdef HTTP_WITH_TLS
+using TLSHandle = SSL*;
+#else
+using TLSHandle = void*;
+#endif
+
+// Conexão com o servidor: socket TCP e, em HTTPS, a sessão TLS sobre ele.
+// Dono de ambos (só move); leituras e escritas passam pelo TLS quando houver.
+class Connection {
+public:
+    Connection() = default;
+    explicit Connection(int fd) : socket(fd) {}
+
+    ~Connection() {
+        reset();
+    }
+
+    Connection(Connection&& other) noexcept : socket(std::move(other.socket)), tls(other.tls) {
+        other.tls = nullptr;
+    }
+
+    Connection& operator=(Connection&& other) noexcept {
+        if (this != &other) {
+            reset();
+            socket = std::move(other.socket);
+            tls = other.tls;
+            other.tls = nullptr;
+        }
+        return *this;
+    }
+
+    Connection(const Connection&) = delete;
+    Connection& operator=(const Connection&) = delete;
+
+    int fd() const { return socket.fd(); }
+    bool secure() const { return tls != nullptr; }
+    explicit operator bool() const { return socket.valid(); }
+
+    // Passa a ser dono da sessão TLS já estabelecida sobre o socket
+    void attach_tls(TLSHandle handle) {
+        tls = handle;
+    }
+
+    void reset() {
+#ifdef HTTP_WITH_TLS
+        if (tls) {
+            // Tickets do TLS 1.3 enviados após a resposta ainda não foram lidos:
+            // uma leitura não bloqueante os entrega ao cache de sessões. Sem
+            // close_notify o OpenSSL marca a sessão como não retomável.
+            has_unexpected_input();
+            SSL_shutdown(tls);
+            ERR_clear_error();
+            SSL_free(tls);
+        }
+#endif
+        tls = nullptr;
+        socket.reset();
+    }
+
+    // Como recv: 0 no fim da conexão, -1 em erro ou timeout
+    ssize_t read(char* buffer, size_t length) {
+#ifdef HTTP_WITH_TLS
+        if (tls) {
+            size_t n = 0;
+            int rc = SSL_read_ex(tls, buffer, length, &n);
+            if (rc == 1) {
+                return static_cast<ssize_t>(n);
+            }
+            int error = SSL_get_error(tls, rc);
+            ERR_clear_error();
+            return error == SSL_ERROR_ZERO_RETURN ? 0 : -1;
+        }
+#endif
+        return recv_some(fd(), buffer, length);
+    }
+
+    bool write(const char* data, size_t length, int flags = 0) {
+#ifdef HTTP_WITH_TLS
+        if (tls) {
+            while (length > 0) {
+                size_t n = 0;
+                if (SSL_write_ex(tls, data, length, &n) != 1) {
+                    ERR_clear_error();
+                    return false;
+                }
+                data += n;
+                length -= n;
+            }
+            return true;
+        }
+#endif
+        return send_all(fd(), data, length, flags);
+    }
+
+    // Em TLS os trechos são agrupados em registros de até 16 KB: um SSL_write
+    // por iovec geraria um registro (e um segmento) para cada header
+    bool write_iov(struct iovec* iov, size_t count) {
+#ifdef HTTP_WITH_TLS
+        if (tls) {
+            std::string record;
+            for (size_t i = 0; i < count; i++) {
+                const char* bytes = static_cast<const char*>(iov[i].iov_base);
+                size_t length = iov[i].iov_len;
+                if (!record.empty() && record.size() + length > TLS_RECORD_SIZE) {
+                    if (!write(record.data(), record.size())) {
+                        return false;
+                    }
+                    record.clear();
+                }
+                if (length >= TLS_RECORD_SIZE) {
+                    if (!write(bytes, length)) {
+                        return false;
+                    }
+                } else {
+                    record.append(bytes, length);
+                }
+            }
+            return record.empty() || write(record.data(), record.size());
+        }
+#endif
+        return send_iov(fd(), iov, count);
+    }
+
+    // Trecho de arquivo: sendfile em texto puro; em TLS, pread + SSL_write
+    // (sendfile não aceita MSG_NOSIGNAL: main ignora SIGPIPE)
+    bool write_file(int file_fd, off_t offset, size_t length) {
+#ifdef HTTP_WITH_TLS
+        if (tls) {
+            BufferPool::Lease buffer = BufferPool::shared().acquire(64 * 1024);
+            while (length > 0) {
+                ssize_t n = pread(file_fd, buffer.data(), std::min(length, buffer.size()), offset);
+                if (n < 0 && errno == EINTR) {
+                    continue;
+                }
+                if (n <= 0 || !write(buffer.data(), n)) {
+                    return false;
+                }
+                offset += n;
+                length -= n;
+            }
+            return true;
+        }
+#endif
+        while (length > 0) {
+            ssize_t n = sendfile(fd(), file_fd, &offset, length);
+            if (n < 0 && errno == EINTR) {
+                continue;
+            }
+            if (n <= 0) {
+                return false;
+            }
+            length -= n;
+        }
+        return true;
+    }
+
+    // Conexão ociosa e legível: EOF ou dados inesperados, salvo registros de
+    // controle do TLS (ex.: NewSessionTicket do TLS 1.3 chegando após a resposta)
+    bool has_unexpected_input() {
+#ifdef HTTP_WITH_TLS
+        if (tls) {
+            int flags = fcntl(fd(), F_GETFL);
+            fcntl(fd(), F_SETFL, flags | O_NONBLOCK);
+            char probe;
+            size_t n = 0;
+            int rc = SSL_peek_ex(tls, &probe, 1, &n);
+            bool idle = rc != 1 && SSL_get_error(tls, rc) == SSL_ERROR_WANT_READ;
+            ERR_clear_error();
+            fcntl(fd(), F_SETFL, flags);
+            return !idle;
+        }
+#endif
+        char probe;
+        ssize_t n = recv(fd(), &probe, 1, MSG_PEEK | MSG_DONTWAIT);
+        return !(n < 0 && (errno == EAGAIN || errno == EWOULDBLOCK));
+    }
+
+private:
+    static constexpr size_t TLS_RECORD_SIZE = 16 * 1024;
+
+    Socket socket;
+    TLSHandle tls = nullptr;
+};
+
+#ifdef HTTP_WITH_TLS
+// Contexto TLS do cliente (OpenSSL). Guarda a sessão mais recente de cada
+// origem (ticket ou ID de sessão) para que reconexões façam o handshake
+// abreviado, e em TLS 1.3 envia a requisição como early data (0-RTT) quando
+// o ticket permite.
+class TLSContext {
+public:
+    struct Stats {
+        size_t full_handshakes = 0;
+        size_t resumed = 0;
+        size_t early_accepted = 0;
+        size_t early_rejected = 0;
+    };
+
+    TLSContext() {
+        ctx = SSL_CTX_new(TLS_client_method());
+        if (!ctx) {
+            return;
+        }
+        SSL_CTX_set_min_proto_version(ctx, TLS1_2_VERSION);
+        SSL_CTX_set_default_verify_paths(ctx);
+        SSL_CTX_set_verify(ctx, SSL_VERIFY_PEER, nullptr);
+#ifdef SSL_OP_IGNORE_UNEXPECTED_EOF
+        // Fechamento sem close_notify vira EOF comum, como em texto puro
+        SSL_CTX_set_options(ctx, SSL_OP_IGNORE_UNEXPECTED_EOF);
+#endif
+        // Sessões ficam no mapa por origem (o cache interno é indexado por ID,
+        // o que só serve ao servidor)
+        SSL_CTX_set_session_cache_mode(ctx, SSL_SESS_CACHE_CLIENT |
+                                                SSL_SESS_CACHE_NO_INTERNAL_STORE);
+        SSL_CTX_sess_set_new_cb(ctx, &TLSContext::on_new_session);
+        SSL_CTX_set_app_data(ctx, this);
+    }
+
+    ~TLSContext() {
+        for (auto& entry : sessions) {
+            SSL_SESSION_free(entry.second);
+        }
+        if (ctx) {
+            SSL_CTX_free(ctx);
+        }
+    }
+
+    TLSContext(const TLSContext&) = delete;
+    TLSContext& operator=(const TLSContext&) = delete;
+
+    // Desativar só para servidores de teste (certificado autoassinado)
+    void set_verify(bool enabled) {
+        if (ctx) {
+            SSL_CTX_set_verify(ctx, enabled ? SSL_VERIFY_PEER : SSL_VERIFY_NONE, nullptr);
+        }
+    }
+
+    void set_early_data(bool enabled) {
+        early_data = enabled;
+    }
+
+    const Stats& stats() const { return counters; }
+
+    // Handshake sobre um socket conectado (SNI e verificação do nome do host).
+    // early é enviado em 0-RTT se a sessão guardada da origem permitir;
+    // early_sent diz se o servidor aceitou (senão cabe ao chamador reenviar).
+    SSL* handshake(int fd, const std::string& host, int port, std::string_view early,
+                   bool& early_sent, std::string& error) {
+        early_sent = false;
+        if (!ctx) {
+            error = "contexto TLS indisponível";
+            return nullptr;
+        }
+
+        SSL* ssl = SSL_new(ctx);
+        if (!ssl) {
+            error = last_error();
+            return nullptr;
+        }
+        SSL_set_fd(ssl, fd);
+
+        // Tickets do TLS 1.3 chegam depois do handshake: a origem fica no SSL
+        std::string origin = host + ":" + std::to_string(port);
+        SSL_set_ex_data(ssl, origin_index(), new std::string(origin));
+
+        unsigned char literal[sizeof(struct in6_addr)];
+        if (inet_pton(AF_INET, host.c_str(), literal) == 1 ||
+            inet_pton(AF_INET6, host.c_str(), literal) == 1) {
+            // Endereço literal: sem SNI, verifica o IP no certificado
+            X509_VERIFY_PARAM_set1_ip_asc(SSL_get0_param(ssl), host.c_str());
+        } else {
+            SSL_set_tlsext_host_name(ssl, host.c_str());
+            SSL_set1_host(ssl, host.c_str());
+        }
+
+        auto cached = sessions.find(origin);
+        bool early_attempted = false;
+        if (cached != sessions.end()) {
+            SSL_set_session(ssl, cached->second);
+
+            // 0-RTT: a requisição vai no primeiro voo, junto do ClientHello
+            if (early_data && !early.empty() &&
+                SSL_SESSION_get_max_early_data(cached->second) >= early.size()) {
+                size_t written = 0;
+                if (SSL_write_early_data(ssl, early.data(), early.size(), &written) != 1 ||
+                    written != early.size()) {
+                    error = last_error();
+                    SSL_free(ssl);
+                    return nullptr;
+                }
+                early_attempted = true;
+            }
+        }
+
+        if (SSL_connect(ssl) != 1) {
+            long verify = SSL_get_verify_result(ssl);
+            error = verify != X509_V_OK ? X509_verify_cert_error_string(verify) : last_error();
+            ERR_clear_error();
+            SSL_free(ssl);
+            return nullptr;
+        }
+
+        if (early_attempted) {
+            early_sent = SSL_get_early_data_status(ssl) == SSL_EARLY_DATA_ACCEPTED;
+            (early_sent ? counters.early_accepted : counters.early_rejected)++;
+        }
+        (SSL_session_reused(ssl) ? counters.resumed : counters.full_handshakes)++;
+        return ssl;
+    }
+
+private:
+    SSL_CTX* ctx = nullptr;
+    std::map<std::string, SSL_SESSION*> sessions;
+    bool early_data = true;
+    Stats counters;
+
+    static void free_origin(void*, void* origin, CRYPTO_EX_DATA*, int, long, void*) {
+        delete static_cast<std::string*>(origin);
+    }
+
+    static int origin_index() {
+        static int index = SSL_get_ex_new_index(0, nullptr, nullptr, nullptr, &free_origin);
+        return index;
+    }
+
+    // Nova sessão (ou ticket) da conexão: substitui a anterior da origem.
+    // Retornar 1 transfere a referência para o mapa.
+    static int on_new_session(SSL* ssl, SSL_SESSION* session) {
+        auto* self = static_cast<TLSContext*>(SSL_CTX_get_app_data(SSL_get_SSL_CTX(ssl)));
+        auto* origin = static_cast<std::string*>(SSL_get_ex_data(ssl, origin_index()));
+        if (!self || !origin || !SSL_SESSION_is_resumable(session)) {
+            return 0;
+        }
+        SSL_SESSION*& slot = self->sessions[*origin];
+        if (slot) {
+            SSL_SESSION_free(slot);
+        }
+        slot = session;
+        return 1;
+    }
+
+    static std::string last_error() {
+        unsigned long code = ERR_get_error();
+        ERR_clear_error();
+        if (code == 0) {
+            return "conexão encerrada durante o handshake";
+        }
+        char text[256];
+        ERR_error_string_n(code, text, sizeof(text));
+        return text;
+    }
+};
+#endif
+
+// Pool de conexões persistentes (HTTP/1.1 keep-alive) indexado por
+// esquema://host:porta; em HTTPS a sessão TLS fica junto (sem novo handshake)
+class ConnectionPool {
+private:
+    struct IdleConnection {
+        Connection connection;
+        std::chrono::steady_clock::time_point expires_at;
+    };
+
+    std::map<std::string, std::deque<IdleConnection>> idle;
+    size_t max_per_host;
+    std::chrono::seconds idle_timeout;
+
+public:
+    ConnectionPool(size_t max_per_host = 4,
+                   std::chrono::seconds idle_timeout = std::chrono::seconds(30))
+        : max_per_host(max_per_host), idle_timeout(idle_timeout) {}
+
+    ConnectionPool(const ConnectionPool&) = delete;
+    ConnectionPool& operator=(const ConnectionPool&) = delete;
+
+    void set_limits(size_t max_per_host, std::chrono::seconds idle_timeout) {
+        this->max_per_host = max_per_host;
+        this->idle_timeout = idle_timeout;
+    }
+
+    // Retorna uma conexão ociosa e saudável para a origem, ou uma vazia se não houver
+    Connection acquire(const std::string& host, int port, bool secure) {
+        auto it = idle.find(key(host, port, secure));
+        if (it == idle.end()) {
+            return Connection();
+        }
+
+        auto now = std::chrono::steady_clock::now();
+        auto& connections = it->second;
+
+        // Usa a conexão mais recente primeiro (menor chance de ter sido fechada)
+        while (!connections.empty()) {
+            IdleConnection entry = std::move(connections.back());
+            connections.pop_back();
+
+            if (entry.expires_at > now && !is_stale(entry.connection)) {
+                return std::move(entry.connection);
+            }
+        }
+
+        return Connection();
+    }
+
+    // Devolve uma conexão ao pool; fecha se o limite por host foi atingido
+    void release(const std::string& host, int port, Connection connection,
+                 std::chrono::seconds server_timeout = std::chrono::seconds(0)) {
+        auto timeout = idle_timeout;
+        if (server_timeout.count() > 0 && server_timeout < timeout) {
+            timeout = server_timeout;
+        }
+
+        if (max_per_host == 0 || timeout.count() <= 0) {
+            return;
+        }
+        auto& connections = idle[key(host, port, connection.secure())];
+
+        // Descarta a conexão mais antiga para respeitar o limite por host
+        while (connections.size() >= max_per_host) {
+            connections.pop_front();
+        }
+
+        connections.push_back({std::move(connection), std::chrono::steady_clock::now() + timeout});
+    }
+
+    void clear() {
+        idle.clear();
+    }
+
+private:
+    static std::string key(const std::string& host, int port, bool secure) {
+        return (secure ? "https://" : "http://") + host + ":" + std::to_string(port);
+    }
+
+    // Conexão ociosa não deve ter nada para ler: EOF ou dados inesperados
+    // indicam que o servidor fechou (ou vai fechar) o socket
+    static bool is_stale(Connection& connection) {
+        struct pollfd pfd{connection.fd(), POLLIN, 0};
+        int ready = poll(&pfd, 1, 0);
+        if (ready < 0) {
+            return true;
+        }
+        if (ready == 0) {
+            return false;
+        }
+        if (pfd.revents & (POLLERR | POLLHUP | POLLNVAL)) {
+            return true;
+        }
+        return connection.has_unexpected_input();
+    }
+};
+
+// Comparação de nomes de headers (não diferenciam maiúsculas/minúsculas)
+static bool iequals(std::string_view a, std::string_view b) {
+    if (a.size() != b.size()) {
+        return false;
+    }
+    for (size_t i = 0; i < a.size(); i++) {
+        if (std::tolower(static_cast<unsigned char>(a[i])) !=
+            std::tolower(static_cast<unsigned char>(b[i]))) {
+            return false;
+        }
+    }
+    return true;
+}
+
+// Busca sem diferenciar maiúsculas/minúsculas (ex: tokens de Connection)
+static bool icontains(std::string_view haystack, std::string_view needle) {
+    if (needle.size() > haystack.size()) {
+        return false;
+    }
+    for (size_t i = 0; i + needle.size() <= haystack.size(); i++) {
+        if (iequals(haystack.substr(i, needle.size()), needle)) {
+            return true;
+        }
+    }
+    return false;
+}
+
+// Mesmo conjunto de espaços que \s; remove do início/fim sem copiar
+static std::string_view trim_view(std::string_view text) {
+    const char* spaces = " \t\n\v\f\r";
+    size_t start = text.find_first_not_of(spaces);
+    if (start == std::string_view::npos) {
+        return {};
+    }
+    size_t end = text.find_last_not_of(spaces);
+    return text.substr(start, end - start + 1);
+}
+
+// Visão de uma URL sobre o texto original (sem alocações)
+struct URLView {
+    std::string_view protocol;
+    std::string_view host;
+    std::string_view port;  // Vazio se ausente
+    std::string_view path;  // Vazio se ausente; começa com '/'
+    std::string_view query; // Inclui o '?'
+};
+
+// Porta, path e query após o host; a URL precisa terminar aqui
+static bool parse_url_tail(std::string_view url, size_t pos, URLView& out) {
+    out.port = out.path = out.query = {};
+
+    if (pos < url.size() && url[pos] == ':') {
+        size_t end = pos + 1;
+        while (end < url.size() && url[end] >= '0' && url[end] <= '9') {
+            end++;
+        }
+        if (end == pos + 1) {
+            return false;
+        }
+        out.port = url.substr(pos + 1, end - pos - 1);
+        pos = end;
+    }
+
+    if (pos < url.size() && url[pos] == '/') {
+        size_t end = std::min(url.find_first_of("?#", pos), url.size());
+        out.path = url.substr(pos, end - pos);
+        pos = end;
+    }
+
+    if (pos < url.size() && url[pos] == '?') {
+        if (url.find('#', pos) != std::string_view::npos) {
+            return false;
+        }
+        out.query = url.substr(pos);
+        pos = url.size();
+    }
+
+    return pos == url.size();
+}
+
+// Parser manual equivalente a regex_match com
+// (https?)://([^:/]+)(?::(\d+))?(/[^?#]*)?(\?[^#]*)?
+static bool parse_url_view(std::string_view url, URLView& out) {
+    out = URLView{};
+
+    size_t pos;
+    if (url.compare(0, 7, "http://") == 0) {
+        out.protocol = url.substr(0, 4);
+        pos = 7;
+    } else if (url.compare(0, 8, "https://") == 0) {
+        out.protocol = url.substr(0, 5);
+        pos = 8;
+    } else {
+        return false;
+    }
+
+    size_t host_end = std::min(url.find_first_of(":/", pos), url.size());
+    if (host_end == pos) {
+        return false;
+    }
+    out.host = url.substr(pos, host_end - pos);
+    if (parse_url_tail(url, host_end, out)) {
+        return true;
+    }
+
+    // Como no backtracking do regex: host mais curto seguido só de query
+    size_t query_start = url.rfind('?', host_end - 1);
+    if (query_start != std::string_view::npos && query_start > pos &&
+        url.find('#', query_start) == std::string_view::npos) {
+        out.host = url.substr(pos, query_start - pos);
+        out.port = out.path = {};
+        out.query = url.substr(query_start);
+        return true;
+    }
+
+    return false;
+}
+
+// Decodificador incremental de Transfer-Encoding: chunked (RFC 7230, seção 4.1)
+//
+// Trabalha direto sobre o buffer de recepção: o payload de cada chunk é
+// entregue ao sink como um ponteiro para dentro do buffer, sem strings
+// intermediárias. Linha de tamanho, extensões e trailers podem chegar
+// divididos entre várias chamadas de recv.
+class ChunkedDecoder {
+public:
+    using DataSink = std::function<void(const char* data, size_t length)>;
+    using TrailerSink = std::function<void(std::string_view line)>;
+
+    static constexpr size_t MAX_LINE_BYTES = 8 * 1024;
+
+    ChunkedDecoder() {
+        reset();
+    }
+
+    void reset() {
+        state = State::SIZE;
+        chunk_remaining = 0;
+        size_digits = 0;
+        line_bytes = 0;
+        trailer_line.clear();
+        error_message.clear();
+    }
+
+    // Consome até length bytes; retorna quantos pertencem ao corpo chunked
+    // (incluindo o chunk final e os trailers). Para no fim da mensagem.
+    size_t decode(const char* data, size_t length, const DataSink& on_data,
+                  const TrailerSink& on_trailer = nullptr) {
+        size_t pos = 0;
+
+        while (pos < length && state != State::DONE && state != State::ERROR) {
+            char c = data[pos];
+
+            switch (state) {
+            case State::SIZE:
+                if (std::isxdigit(static_cast<unsigned char>(c))) {
+                    if (chunk_remaining > (UINT64_MAX >> 4)) {
+                        fail("Tamanho de chunk muito grande");
+                        break;
+                    }
+                    chunk_remaining = (chunk_remaining << 4) | hex_value(c);
+                    size_digits++;
+                    pos++;
+                } else if (c == ';' || c == ' ' || c == '\t') {
+                    state = State::EXTENSION;
+                    pos++;
+                } else if (c == '\r') {
+                    state = State::SIZE_LF;
+                    pos++;
+                } else if (c == '\n') {
+                    pos++;
+                    end_size_line();
+                } else {
+                    fail("Linha de tamanho de chunk inválida");
+                }
+                break;
+
+            case State::EXTENSION: {
+                // Extensões (;nome=valor) são ignoradas
+                const char* end = static_cast<const char*>(memchr(data + pos, '\n', length - pos));
+                size_t skip = end ? static_cast<size_t>(end - data) - pos : length - pos;
+                line_bytes += skip;
+                if (line_bytes > MAX_LINE_BYTES) {
+                    fail("Extensão de chunk muito grande");
+                    break;
+                }
+                pos += skip;
+                if (end) {
+                    pos++;
+                    end_size_line();
+                }
+                break;
+            }
+
+            case State::SIZE_LF:
+                if (c != '\n') {
+                    fail("Esperado LF após tamanho do chunk");
+                    break;
+                }
+                pos++;
+                end_size_line();
+                break;
+
+            case State::DATA: {
+                size_t n = static_cast<size_t>(
+                    std::min<uint64_t>(chunk_remaining, length - pos));
+                if (on_data) {
+                    on_data(data + pos, n);
+                }
+                pos += n;
+                chunk_remaining -= n;
+                if (chunk_remaining == 0) {
+                    state = State::DATA_CR;
+                }
+                break;
+            }
+
+            case State::DATA_CR:
+                if (c == '\r') {
+                    state = State::DATA_LF;
+                } else if (c == '\n') {
+                    start_size_line();
+                } else {
+                    fail("Esperado CRLF após dados do chunk");
+                    break;
+                }
+                pos++;
+                break;
+
+            case State::DATA_LF:
+                if (c != '\n') {
+                    fail("Esperado CRLF após dados do chunk");
+                    break;
+                }
+                pos++;
+                start_size_line();
+                break;
+
+            case State::TRAILER: {
+                const char* end = static_cast<const char*>(memchr(data + pos, '\n', length - pos));
+                size_t take = end ? static_cast<size_t>(end - data) - pos : length - pos;
+                line_bytes += take;
+                if (line_bytes > MAX_LINE_BYTES) {
+                    fail("Trailers muito grandes");
+                    break;
+                }
+                if (!end) {
+                    trailer_line.append(data + pos, take);
+                    pos += take;
+                    break;
+                }
+
+                // Linha inteira no buffer é usada sem cópia
+                std::string_view current(data + pos, take);
+                if (!trailer_line.empty()) {
+                    trailer_line.append(data + pos, take);
+                    current = trailer_line;
+                }
+                pos += take + 1;
+
+                if (!current.empty() && current.back() == '\r') {
+                    current.remove_suffix(1);
+                }
+                if (current.empty()) {
+                    state = State::DONE; // Linha vazia encerra a mensagem
+                } else if (on_trailer) {
+                    on_trailer(current);
+                }
+                trailer_line.clear();
+                break;
+            }
+
+            case State::DONE:
+            case State::ERROR:
+                break;
+            }
+        }
+
+        return pos;
+    }
+
+    bool done() const { return state == State::DONE; }
+    bool failed() const { return state == State::ERROR; }
+    const std::string& error() const { return error_message; }
+
+private:
+    enum class State {
+        SIZE,      // Dígitos hexadecimais do tamanho
+        EXTENSION, // ;nome=valor até o fim da linha
+        SIZE_LF,
+        DATA,      // Payload do chunk
+        DATA_CR,
+        DATA_LF,
+        TRAILER,   // Campos após o chunk final, terminados por linha vazia
+        DONE,
+        ERROR
+    };
+
+    State state;
+    uint64_t chunk_remaining;
+    size_t size_digits;
+    size_t line_bytes;
+    std::string trailer_line;
+    std::string error_message;
+
+    static unsigned hex_value(char c) {
+        if (c >= '0' && c <= '9') return c - '0';
+        if (c >= 'a' && c <= 'f') return c - 'a' + 10;
+        return c - 'A' + 10;
+    }
+
+    void fail(const std::string& message) {
+        state = State::ERROR;
+        error_message = message;
+    }
+
+    void start_size_line() {
+        state = State::SIZE;
+        chunk_remaining = 0;
+        size_digits = 0;
+        line_bytes = 0;
+    }
+
+    void end_size_line() {
+        if (size_digits == 0) {
+            fail("Linha de tamanho de chunk vazia");
+            return;
+        }
+        line_bytes = 0;
+        state = chunk_remaining == 0 ? State::TRAILER : State::DATA;
+    }
+};
+
+// Decodificador incremental de Content-Encoding (gzip, deflate, br)
+//
+// Cada segmento do corpo é descomprimido assim que chega, num buffer de saída
+// fixo entregue ao sink sempre que enche: o corpo comprimido nunca é
+// acumulado. Cada codificação depende de uma opção de compilação
+// (HTTP_WITH_ZLIB para gzip/deflate, HTTP_WITH_BROTLI para br).
+class ContentDecoder {
+public:
+    using DataSink = std::function<void(const char* data, size_t length)>;
+
+    enum class Coding { IDENTITY, GZIP, DEFLATE, BROTLI };
+
+    static constexpr size_t OUTPUT_BYTES = 64 * 1024;
+
+    ContentDecoder() = default;
+
+    ~ContentDecoder() {
+        reset();
+    }
+
+    ContentDecoder(const ContentDecoder&) = delete;
+    ContentDecoder& operator=(const ContentDecoder&) = delete;
+
+    // Valor de Accept-Encoding com as codificações compiladas (vazio se nenhuma)
+    static const std::string& accept_encoding() {
+        static const std::string value = [] {
+            std::string list;
+#ifdef HTTP_WITH_BROTLI
+            list += "br";
+#endif
+#ifdef HTTP_WITH_ZLIB
+            list += list.empty() ? "gzip, deflate" : ", gzip, deflate";
+#endif
+            return list;
+        }();
+        return value;
+    }
+
+    // Codificação de um Content-Encoding; IDENTITY se ausente ou não suportada
+    // aqui (inclusive empilhadas como "gzip, br": o corpo segue comprimido)
+    static Coding parse(std::string_view value) {
+        value = trim_view(value);
+#ifdef HTTP_WITH_ZLIB
+        if (iequals(value, "gzip") || iequals(value, "x-gzip")) {
+            return Coding::GZIP;
+        }
+        if (iequals(value, "deflate")) {
+            return Coding::DEFLATE;
+        }
+#endif
+#ifdef HTTP_WITH_BROTLI
+        if (iequals(value, "br")) {
+            return Coding::BROTLI;
+        }
+#endif
+        (void)value;
+        return Coding::IDENTITY;
+    }
+
+    void start(Coding value) {
+        reset();
+        coding = value;
+        if (coding != Coding::IDENTITY && !output) {
+            output.reset(new char[OUTPUT_BYTES]);
+        }
+#ifdef HTTP_WITH_BROTLI
+        if (coding == Coding::BROTLI) {
+            brotli = BrotliDecoderCreateInstance(nullptr, nullptr, nullptr);
+            if (!brotli) {
+                error_message = "Erro ao iniciar o decodificador brotli";
+            }
+        }
+#endif
+    }
+
+    void reset() {
+#ifdef HTTP_WITH_ZLIB
+        if (zlib_ready) {
+            inflateEnd(&zlib);
+            zlib_ready = false;
+        }
+#endif
+#ifdef HTTP_WITH_BROTLI
+        if (brotli) {
+            BrotliDecoderDestroyInstance(brotli);
+            brotli = nullptr;
+        }
+#endif
+        coding = Coding::IDENTITY;
+        stream_end = false;
+        produced = 0;
+        error_message.clear();
+    }
+
+    bool active() const { return coding != Coding::IDENTITY; }
+    bool failed() const { return !error_message.empty(); }
+    const std::string& error() const { return error_message; }
+    size_t decoded_bytes() const { return produced; }
+
+    // Descomprime um segmento; retorna false em dados inválidos
+    bool decode(const char* data, size_t length, const DataSink& sink) {
+        if (failed()) {
+            return false;
+        }
+        // Dados após o fim do stream comprimido são ignorados
+        if (stream_end || length == 0) {
+            return true;
+        }
+#ifdef HTTP_WITH_ZLIB
+        if (coding == Coding::GZIP || coding == Coding::DEFLATE) {
+            return inflate_segment(data, length, sink);
+        }
+#endif
+#ifdef HTTP_WITH_BROTLI
+        if (coding == Coding::BROTLI) {
+            return brotli_segment(data, length, sink);
+        }
+#endif
+        (void)data;
+        (void)sink;
+        return true;
+    }
+
+    // Fim do corpo: o stream comprimido precisa ter terminado
+    bool finish() {
+        if (active() && !failed() && !stream_end) {
+            error_message = "Corpo comprimido truncado";
+        }
+        return !failed();
+    }
+
+private:
+    Coding coding = Coding::IDENTITY;
+    std::unique_ptr<char[]> output;
+    bool stream_end = false;
+    size_t produced = 0;
+    std::string error_message;
+#ifdef HTTP_WITH_ZLIB
+    z_stream zlib{};
+    bool zlib_ready = false;
+#endif
+#ifdef HTTP_WITH_BROTLI
+    BrotliDecoderState* brotli = nullptr;
+#endif
+
+    void emit(size_t length, const DataSink& sink) {
+        produced += length;
+        if (length > 0 && sink) {
+            sink(output.get(), length);
+        }
+    }
+
+#ifdef HTTP_WITH_ZLIB
+    bool inflate_segment(const char* data, size_t length, const DataSink& sink) {
+        if (!zlib_ready) {
+            // "deflate" deveria vir com cabeçalho zlib (RFC 9110, seção 8.4.1.2),
+            // mas há servidores que mandam deflate cru: o primeiro byte (CMF) decide
+            int window = 15 + 16;
+            if (coding == Coding::DEFLATE) {
+                unsigned char cmf = static_cast<unsigned char>(data[0]);
+                window = ((cmf & 0x0f) == 8 && (cmf >> 4) <= 7) ? 15 : -15;
+            }
+            if (inflateInit2(&zlib, window) != Z_OK) {
+                error_message = "Erro ao iniciar o zlib";
+                return false;
+            }
+            zlib_ready = true;
+        }
+
+        zlib.next_in = reinterpret_cast<Bytef*>(const_cast<char*>(data));
+        zlib.avail_in = static_cast<uInt>(length);
+        while (true) {
+            zlib.next_out = reinterpret_cast<Bytef*>(output.get());
+            zlib.avail_out = OUTPUT_BYTES;
+            int rc = inflate(&zlib, Z_NO_FLUSH);
+            emit(OUTPUT_BYTES - zlib.avail_out, sink);
+
+            if (rc == Z_STREAM_END) {
+                // gzip pode ter vários membros concatenados
+                if (coding == Coding::GZIP && zlib.avail_in > 0) {
+                    inflateReset(&zlib);
+                    continue;
+                }
+                stream_end = true;
+                return true;
+            }
+            if (rc != Z_OK && rc != Z_BUF_ERROR) {
+                error_message = std::string("Erro ao descomprimir: ") +
+                                (zlib.msg ? zlib.msg : "dados inválidos");
+                return false;
+            }
+            // Saída não encheu: toda a entrada foi consumida
+            if (zlib.avail_out > 0) {
+                return true;
+            }
+        }
+    }
+#endif
+
+#ifdef HTTP_WITH_BROTLI
+    bool brotli_segment(const char* data, size_t length, const DataSink& sink) {
+        const uint8_t* next_in = reinterpret_cast<const uint8_t*>(data);
+        size_t available_in = length;
+        while (true) {
+            uint8_t* next_out = reinterpret_cast<uint8_t*>(output.get());
+            size_t available_out = OUTPUT_BYTES;
+            BrotliDecoderResult rc = BrotliDecoderDecompressStream(
+                brotli, &available_in, &next_in, &available_out, &next_out, nullptr);
+            emit(OUTPUT_BYTES - available_out, sink);
+
+            if (rc == BROTLI_DECODER_RESULT_SUCCESS) {
+                stream_end = true;
+                return true;
+            }
+            if (rc == BROTLI_DECODER_RESULT_NEEDS_MORE_INPUT) {
+                return true;
+            }
+            if (rc == BROTLI_DECODER_RESULT_ERROR) {
+                error_message = std::string("Erro ao descomprimir: ") +
+                                BrotliDecoderErrorString(BrotliDecoderGetErrorCode(brotli));
+                return false;
+            }
+        }
+    }
+#endif
+};
+
+// Parser incremental de respostas HTTP/1.1 (máquina de estados)
+//
+// Consome os bytes à medida que chegam do socket e entrega status, headers e
+// segmentos do corpo por callbacks, sem esperar o fechamento da conexão.
+// feed() para exatamente no fim da mensagem: bytes não consumidos pertencem à
+// próxima resposta da mesma conexão.
+class HTTPResponseParser {
+public:
+    // Views apontam para o buffer da chamada de feed() e só valem durante o callback
+    using StatusCallback = std::function<void(std::string_view version, int status_code,
+                                              std::string_view status_text)>;
+    using HeaderCallback = std::function<void(std::string_view name, std::string_view value)>;
+    using BodyCallback = std::function<void(const char* data, size_t length)>;
+    using EventCallback = std::function<void()>;
+
+    enum class State {
+        STATUS_LINE,
+        HEADERS,
+        BODY_FIXED,       // Corpo delimitado por Content-Length
+        BODY_CHUNKED,     // Transfer-Encoding: chunked
+        BODY_UNTIL_CLOSE, // Sem delimitação: corpo termina no EOF
+        COMPLETE,
+        ERROR
+    };
+
+    static constexpr size_t MAX_HEADER_BYTES = 64 * 1024;
+
+    StatusCallback on_status;
+    HeaderCallback on_header;
+    EventCallback on_headers_complete;
+    BodyCallback on_body;
+    HeaderCallback on_trailer;
+    EventCallback on_message_complete;
+
+    HTTPResponseParser() {
+        // Payload dos chunks passa pela mesma contagem e decodificação do corpo
+        body_sink = [this](const char* data, size_t length) {
+            emit_body(data, length);
+        };
+        // Trailers do corpo chunked usam o mesmo tokenizador dos headers
+        on_trailer_line = [this](std::string_view trailer) {
+            std::string_view key, value;
+            if (on_trailer && parse_header_line(trailer, key, value)) {
+                on_trailer(key, value);
+            }
+        };
+        reset();
+    }
+
+    HTTPResponseParser(const HTTPResponseParser&) = delete;
+    HTTPResponseParser& operator=(const HTTPResponseParser&) = delete;
+
+    // Prepara o parser para uma nova resposta (HEAD nunca tem corpo)
+    void reset(bool head_request = false) {
+        state = State::STATUS_LINE;
+        this->head_request = head_request;
+        start_message();
+    }
+
+    // Descomprime o corpo conforme Content-Encoding (vale para as próximas
+    // mensagens; codificações não suportadas chegam como vieram)
+    void set_content_decoding(bool enabled) {
+        decode_content = enabled;
+    }
+
+    // Consome até length bytes e retorna quantos pertencem a esta mensagem
+    size_t feed(const char* data, size_t length) {
+        size_t pos = 0;
+
+        while (pos < length && state != State::COMPLETE && state != State::ERROR) {
+            switch (state) {
+            case State::STATUS_LINE:
+            case State::HEADERS: {
+                const char* newline = static_cast<const char*>(
+                    memchr(data + pos, '\n', length - pos));
+                size_t end = newline ? static_cast<size_t>(newline - data) : length;
+
+                header_bytes += end - pos;
+                if (header_bytes > MAX_HEADER_BYTES) {
+                    fail("Headers HTTP muito grandes");
+                    break;
+                }
+
+                if (!newline) {
+                    line.append(data + pos, end - pos);
+                    pos = length;
+                    break;
+                }
+
+                // Linha inteira no buffer é analisada sem cópia
+                std::string_view current(data + pos, end - pos);
+                if (!line.empty()) {
+                    line.append(data + pos, end - pos);
+                    current = line;
+                }
+                pos = end + 1;
+
+                if (!current.empty() && current.back() == '\r') {
+                    current.remove_suffix(1);
+                }
+                process_line(current);
+                line.clear();
+                break;
+            }
+
+            case State::BODY_FIXED: {
+                size_t n = std::min(length - pos, body_remaining);
+                emit_body(data + pos, n);
+                pos += n;
+                body_remaining -= n;
+                if (body_remaining == 0) {
+                    complete_message();
+                }
+                break;
+            }
+
+            case State::BODY_CHUNKED: {
+                // Payload dos chunks vai ao on_body apontando para o buffer
+                pos += chunked_decoder.decode(data + pos, length - pos, body_sink, on_trailer_line);
+                if (chunked_decoder.failed()) {
+                    fail(chunked_decoder.error());
+                } else if (chunked_decoder.done()) {
+                    complete_message();
+                }
+                break;
+            }
+
+            case State::BODY_UNTIL_CLOSE:
+                emit_body(data + pos, length - pos);
+                pos = length;
+                break;
+
+            case State::COMPLETE:
+            case State::ERROR:
+                break;
+            }
+        }
+
+        return pos;
+    }
+
+    // Sinaliza EOF da conexão
+    void finish() {
+        if (state == State::BODY_UNTIL_CLOSE) {
+            complete_message();
+        } else if (state != State::COMPLETE && state != State::ERROR) {
+            fail(state == State::STATUS_LINE && header_bytes == 0
+                     ? "Nenhuma resposta recebida"
+                     : "Conexão encerrada antes do fim da resposta");
+        }
+    }
+
+    State current_state() const { return state; }
+    bool complete() const { return state == State::COMPLETE; }
+    bool failed() const { return state == State::ERROR; }
+    const std::string& error() const { return error_message; }
+    size_t content_length() const { return declared_length; }
+    // Corpo como veio na conexão (sem o enquadramento chunked) e após o Content-Encoding
+    size_t encoded_body_bytes() const { return body_bytes; }
+    size_t decoded_body_bytes() const {
+        return content_decoder.active() ? content_decoder.decoded_bytes() : body_bytes;
+    }
+
+    // Corpo de tamanho fixo sem Content-Encoding: bytes que o chamador pode
+    // copiar direto da conexão (ex.: splice) e depois informar em skip_body()
+    size_t raw_body_remaining() const {
+        return state == State::BODY_FIXED && !content_decoder.active() ? body_remaining : 0;
+    }
+
+    void skip_body(size_t length) {
+        length = std::min(length, raw_body_remaining());
+        body_bytes += length;
+        body_remaining -= length;
+        if (length > 0 && body_remaining == 0) {
+            complete_message();
+        }
+    }
+
+    // A conexão pode ser reutilizada após esta resposta?
+    bool keep_alive() const {
+        if (state != State::COMPLETE || until_close) {
+            return false;
+        }
+        if (version == "HTTP/1.1") {
+            return !connection_close;
+        }
+        return connection_keep_alive; // HTTP/1.0 só com Connection: keep-alive
+    }
+
+private:
+    State state;
+    bool head_request;
+    std::string line;
+    size_t header_bytes;
+    std::string error_message;
+
+    // Estado da mensagem atual
+    std::string version;
+    int status_code;
+    bool interim;
+    bool chunked;
+    bool has_content_length;
+    size_t declared_length;
+    size_t body_remaining;
+    bool connection_close;
+    bool connection_keep_alive;
+    bool until_close;
+    ContentDecoder::Coding content_coding;
+    size_t body_bytes;
+    ChunkedDecoder chunked_decoder;
+    ChunkedDecoder::DataSink body_sink;
+    ChunkedDecoder::TrailerSink on_trailer_line;
+    bool decode_content = false;
+    ContentDecoder content_decoder;
+
+    void start_message() {
+        line.clear();
+        header_bytes = 0;
+        error_message.clear();
+        version.clear();
+        status_code = 0;
+        interim = false;
+        chunked = false;
+        has_content_length = false;
+        declared_length = 0;
+        body_remaining = 0;
+        connection_close = false;
+        connection_keep_alive = false;
+        until_close = false;
+        content_coding = ContentDecoder::Coding::IDENTITY;
+        body_bytes = 0;
+        chunked_decoder.reset();
+        content_decoder.reset();
+    }
+
+    void fail(const std::string& message) {
+        state = State::ERROR;
+        error_message = message;
+    }
+
+    void emit_body(const char* data, size_t length) {
+        if (length == 0 || state == State::ERROR) {
+            return;
+        }
+        body_bytes += length;
+        if (content_decoder.active()) {
+            if (!content_decoder.decode(data, length, on_body)) {
+                fail(content_decoder.error());
+            }
+        } else if (on_body) {
+            on_body(data, length);
+        }
+    }
+
+    void complete_message() {
+        if (state == State::ERROR) {
+            return;
+        }
+        // Corpo vazio é aceito mesmo com Content-Encoding declarado
+        if (content_decoder.active() && body_bytes > 0 && !content_decoder.finish()) {
+            fail(content_decoder.error());
+            return;
+        }
+        state = State::COMPLETE;
+        if (on_message_complete) {
+            on_message_complete();
+        }
+    }
+
+    void process_line(std::string_view current) {
+        if (state == State::STATUS_LINE) {
+            // Tolera linhas vazias antes da linha de status (RFC 7230, seção 3.5)
+            if (current.empty()) {
+                return;
+            }
+
+            std::string_view version_view, status_text;
+            if (!parse_status_line(current, version_view, status_code, status_text) ||
+                version_view.compare(0, 5, "HTTP/") != 0 || status_code < 100) {
+                fail("Linha de status inválida: " + std::string(current));
+                return;
+            }
+            version.assign(version_view);
+
+            // Respostas 1xx intermediárias (ex: 100 Continue) são descartadas
+            interim = status_code < 200 && status_code != 101;
+            if (!interim && on_status) {
+                on_status(version, status_code, status_text);
+            }
+            state = State::HEADERS;
+            return;
+        }
+
+        if (current.empty()) {
+            headers_complete();
+            return;
+        }
+
+        std::string_view key, value;
+        if (!parse_header_line(current, key, value)) {
+            return;
+        }
+
+        if (iequals(key, "Content-Length")) {
+            uint64_t length = 0;
+            auto result = std::from_chars(value.data(), value.data() + value.size(), length);
+            if (result.ec != std::errc() || result.ptr != value.data() + value.size()) {
+                fail("Content-Length inválido: " + std::string(value));
+                return;
+            }
+            declared_length = length;
+            has_content_length = true;
+        } else if (iequals(key, "Transfer-Encoding")) {
+            chunked = icontains(value, "chunked");
+        } else if (iequals(key, "Connection")) {
+            connection_close = icontains(value, "close");
+            connection_keep_alive = icontains(value, "keep-alive");
+        } else if (iequals(key, "Content-Encoding")) {
+            content_coding = ContentDecoder::parse(value);
+        }
+
+        if (!interim && on_header) {
+            on_header(key, value);
+        }
+    }
+
+    void headers_complete() {
+        if (interim) {
+            bool head = head_request;
+            reset(head);
+            return;
+        }
+
+        if (on_headers_complete) {
+            on_headers_complete();
+        }
+
+        // Determinar como o corpo é delimitado (RFC 7230, seção 3.3.3)
+        if (head_request || status_code == 204 || status_code == 304) {
+            complete_message();
+            return;
+        }
+
+        if (decode_content && content_coding != ContentDecoder::Coding::IDENTITY) {
+            content_decoder.start(content_coding);
+            if (content_decoder.failed()) {
+                fail(content_decoder.error());
+                return;
+            }
+        }
+
+        if (chunked) {
+            state = State::BODY_CHUNKED;
+        } else if (has_content_length) {
+            body_remaining = declared_length;
+            state = State::BODY_FIXED;
+            if (body_remaining == 0) {
+                complete_message();
+            }
+        } else {
+            until_close = true;
+            state = State::BODY_UNTIL_CLOSE;
+        }
+    }
+
+public:
+    // "HTTP/1.1 200 OK" -> versão, código e texto; views apontam para line
+    static bool parse_status_line(std::string_view line, std::string_view& version,
+                                  int& status_code, std::string_view& status_text) {
+        line = trim_view(line);
+        size_t version_end = line.find_first_of(" \t");
+        if (version_end == std::string_view::npos) {
+            return false;
+        }
+        version = line.substr(0, version_end);
+
+        std::string_view rest = trim_view(line.substr(version_end));
+        size_t code_end = 0;
+        while (code_end < rest.size() && rest[code_end] >= '0' && rest[code_end] <= '9') {
+            code_end++;
+        }
+        if (code_end != 3) {
+            return false;
+        }
+        status_code = (rest[0] - '0') * 100 + (rest[1] - '0') * 10 + (rest[2] - '0');
+
+        // Texto do status (resto da linha, pode ser vazio)
+        status_text = trim_view(rest.substr(code_end));
+        return true;
+    }
+
+    // "Nome: valor" -> nome e valor sem espaços nas pontas; views apontam para line
+    static bool parse_header_line(std::string_view line, std::string_view& key,
+                                  std::string_view& value) {
+        size_t colon_pos = line.find(':');
+        if (colon_pos == std::string_view::npos) {
+            return false;
+        }
+
+        key = trim_view(line.substr(0, colon_pos));
+        value = trim_view(line.substr(colon_pos + 1));
+        return true;
+    }
+};
+
+// write em laço (escritas parciais e EINTR)
+static bool write_all(int fd, const char* data, size_t length) {
+    while (length > 0) {
+        ssize_t n = write(fd, data, length);
+        if (n < 0 && errno == EINTR) {
+            continue;
+        }
+        if (n <= 0) {
+            return false;
+        }
+        data += n;
+        length -= n;
+    }
+    return true;
+}
+
+class HTTPClient {
+private:
+    std::string user_agent;
+    ConnectionPool pool;
+    // Buffer reutilizável para linha de requisição e headers
+    std::string request_head;
+    // Origens (host:porta) que falharam com pipelining
+    std::set<std::string> pipelining_disabled;
+    // Opções aplicadas a cada conexão nova, antes do connect
+    SocketTuning tuning;
+    // Envia Accept-Encoding e descomprime as respostas
+    bool accept_encoding = false;
+    // Descritor que recebe os corpos sem on_body (-1: response.body)
+    int body_output = -1;
+#ifdef HTTP_WITH_TLS
+    // Sessões TLS por origem, compartilhadas pelas conexões do pool
+    TLSContext tls;
+#endif
+
+    friend class AsyncHTTPEngine;
+
+public:
+    // Recebe segmentos do corpo à medida que chegam (sem acumular em memória)
+    using BodyCallback = HTTPResponseParser::BodyCallback;
+
+    HTTPClient() : user_agent("CustomHTTPClient/1.0") {}
+
+    // Configura o pool de conexões persistentes
+    void set_pool_limits(size_t max_per_host, std::chrono::seconds idle_timeout) {
+        pool.set_limits(max_per_host, idle_timeout);
+    }
+
+    // TCP_NODELAY, buffers do socket e TCP Fast Open das próximas conexões
+    void set_socket_tuning(const SocketTuning& value) {
+        tuning = value;
+    }
+
+    // Negocia compressão (gzip/deflate/br, conforme compilado); o corpo é
+    // descomprimido à medida que chega. Retorna false se nenhuma foi compilada.
+    bool set_accept_encoding(bool enabled) {
+        accept_encoding = enabled && !ContentDecoder::accept_encoding().empty();
+        return accept_encoding || !enabled;
+    }
+
+    // Corpos das respostas (sem on_body) vão direto para fd, sem passar por
+    // response.body: write de cada segmento ou, em HTTP sem compressão com
+    // Content-Length, splice da conexão para fd. -1 volta ao padrão.
+    void set_body_output(int fd) {
+        body_output = fd;
+    }
+
+    // Verificação de certificado e 0-RTT das conexões HTTPS
+    void set_tls_options(bool verify, bool early_data) {
+#ifdef HTTP_WITH_TLS
+        tls.set_verify(verify);
+        tls.set_early_data(early_data);
+#else
+        (void)verify;
+        (void)early_data;
+#endif
+    }
+
+#ifdef HTTP_WITH_TLS
+    // Handshakes completos, retomados e early data aceita/recusada
+    const TLSContext::Stats& tls_stats() const {
+        return tls.stats();
+    }
+#endif
+
+    struct HTTPResponse {
+        std::string version;
+        int status_code;
+        std::string status_text;
+        std::map<std::string, std::string> headers;
+        std::string body;
+        size_t content_length;
+        size_t wire_length;    // Corpo como chegou (comprimido, sem enquadramento chunked)
+        size_t decoded_length; // Corpo após o Content-Encoding
+        PhaseTrace trace;      // Tempos por fase (vazio sem -DPROTOCOLS_TRACE)
+
+        HTTPResponse() : status_code(0), content_length(0), wire_length(0), decoded_length(0) {}
+    };
+
+    // Status e headers prontos, antes do primeiro segmento do corpo
+    using HeadersCallback = std::function<void(const HTTPResponse& response)>;
+
+    struct URL {
+        std::string protocol;
+        std::string host;
+        int port;
+        std::string path;
+        std::string query;
+
+        URL() : port(80) {}
+
+        bool parse(const std::string& url) {
+            URLView view;
+            if (!parse_url_view(url, view)) {
+                std::cerr << "URL inválida: " << url << std::endl;
+                return false;
+            }
+
+            protocol.assign(view.protocol);
+            host.assign(view.host);
+
+            // Porta padrão baseada no protocolo
+            if (!view.port.empty()) {
+                int value = 0;
+                auto result = std::from_chars(view.port.data(),
+                                              view.port.data() + view.port.size(), value);
+                if (result.ec != std::errc() || value <= 0 || value > 65535) {
+                    std::cerr << "Porta inválida: " << view.port << std::endl;
+                    return false;
+                }
+                port = value;
+            } else {
+                port = (protocol == "https") ? 443 : 80;
+            }
+
+            path = view.path.empty() ? "/" : std::string(view.path);
+            query.assign(view.query);
+
+            return true;
+        }
+    };
+
+    // Corpo da requisição sem cópia: memória do chamador ou trecho de arquivo
+    // (enviado com sendfile)
+    struct RequestBody {
+        std::string_view data;
+        int file_fd = -1;
+        off_t file_offset = 0;
+        size_t file_length = 0;
+
+        size_t length() const { return file_fd >= 0 ? file_length : data.size(); }
+    };
+
+    HTTPResponse request(const std::string& method, const std::string& url_str,
+                        const std::string& body = "",
+                        const std::map<std::string, std::string>& custom_headers = {},
+                        const BodyCallback& on_body = nullptr,
+                        const HeadersCallback& on_headers = nullptr) {
+        RequestBody request_body;
+        request_body.data = body;
+        return perform(method, url_str, request_body, custom_headers, on_body, on_headers);
+    }
+
+    // Envia o conteúdo de um arquivo como corpo (upload sem carregar em memória)
+    HTTPResponse request_file(const std::string& method, const std::string& url_str,
+                              const std::string& path,
+                              const std::map<std::string, std::string>& custom_headers = {},
+                              const BodyCallback& on_body = nullptr,
+                              const HeadersCallback& on_headers = nullptr) {
+        int fd = open(path.c_str(), O_RDONLY | O_CLOEXEC);
+        struct stat info{};
+        if (fd < 0 || fstat(fd, &info) < 0 || !S_ISREG(info.st_mode)) {
+            std::cerr << "Erro ao abrir arquivo: " << path << std::endl;
+            if (fd >= 0) {
+                close(fd);
+            }
+            return HTTPResponse();
+        }
+
+        RequestBody request_body;
+        request_body.file_fd = fd;
+        request_body.file_length = info.st_size;
+        HTTPResponse response = perform(method, url_str, request_body, custom_headers, on_body,
+                                        on_headers);
+        close(fd);
+        return response;
+    }
+
+    HTTPResponse perform(const std::string& method, const std::string& url_str,
+                         const RequestBody& body,
+                         const std::map<std::string, std::string>& custom_headers = {},
+                         const BodyCallback& on_body = nullptr,
+                         const HeadersCallback& on_headers = nullptr) {
+        HTTPResponse response;
+
+        // Parse da URL
+        URL url;
+        if (!url.parse(url_str)) {
+            return response;
+        }
+
+        // Construir headers no buffer reutilizável; o corpo segue separado
+        build_http_request(method, url, body.length(), custom_headers, request_head);
+
+        PhaseTrace trace;
+        trace.begin();
+
+        // Uma conexão reaproveitada pode ter sido fechada pelo servidor entre o
+        // teste de conexão obsoleta e o envio; nesse caso tenta uma conexão nova
+        for (int attempt = 0; attempt < 2; attempt++) {
+            bool reused = true;
+            bool early_sent = false;
+            Connection conn = pool.acquire(url.host, url.port, url.protocol == "https");
+            if (!conn) {
+                reused = false;
+                // 0-RTT só para métodos seguros sem corpo: early data pode ser
+                // reproduzida por um atacante (RFC 8470)
+                std::string_view early;
+                if (body.length() == 0 && is_safe(method)) {
+                    early = request_head;
+                }
+                conn = open_connection(url, early, early_sent, trace);
+                if (!conn) {
+                    return response;
+                }
+            }
+
+            // Enviar requisição (já enviada se foi aceita como early data)
+            if (!early_sent) {
+                if (!send_request(conn, request_head, body)) {
+                    if (reused) {
+                        continue;
+                    }
+                    std::cerr << "Erro ao enviar requisição" << std::endl;
+                    return response;
+                }
+                trace.count_write(request_head.size() + body.length(), body.file_fd >= 0 ? 2 : 1);
+                trace.mark(TracePhase::WRITE);
+            }
+
+            // Receber resposta
+            bool keep_alive = false;
+            std::chrono::seconds server_timeout(0);
+            response = receive_http_response(conn, method, keep_alive, server_timeout, on_body,
+                                             nullptr, trace, on_headers);
+
+            if (response.status_code == 0) {
+                // Só repete se nada da resposta chegou (o corpo pode já ter sido entregue)
+                if (reused && response.version.empty()) {
+                    continue;
+                }
+                return response;
+            }
+
+            if (keep_alive) {
+                pool.release(url.host, url.port, std::move(conn), server_timeout);
+            }
+            return response;
+        }
+
+        std::cerr << "Erro ao reutilizar conexão com " << url.host << std::endl;
+        return response;
+    }
+
+    // Item de um lote de requisições (batch)
+    struct BatchRequest {
+        std::string method;
+        std::string url;
+        std::string body;
+        std::map<std::string, std::string> headers;
+    };
+
+    struct BatchResult {
+        HTTPResponse response;
+        std::chrono::microseconds latency; // Do envio até a resposta completa
+        bool pipelined;                    // Enviada em pipeline (false: sequencial)
+    };
+
+    // Máximo de requisições escritas de uma vez antes de ler as respostas
+    static constexpr size_t PIPELINE_DEPTH = 16;
+
+    // Executa um lote: requisições idempotentes consecutivas para a mesma
+    // origem são escritas em pipeline numa única conexão (HTTP/1.1, RFC 7230
+    // seção 6.3.2) e as respostas são associadas na ordem de envio. Servidores
+    // que quebram com pipelining passam a ser atendidos em modo sequencial.
+    std::vector<BatchResult> batch(const std::vector<BatchRequest>& requests) {
+        std::vector<BatchResult> results(requests.size());
+        std::vector<URL> urls(requests.size());
+        std::vector<bool> valid(requests.size());
+        for (size_t i = 0; i < requests.size(); i++) {
+            valid[i] = urls[i].parse(requests[i].url);
+        }
+
+        size_t i = 0;
+        while (i < requests.size()) {
+            if (!valid[i]) {
+                results[i] = {HTTPResponse(), std::chrono::microseconds(0), false};
+                i++;
+                continue;
+            }
+
+            // Janela: requisições idempotentes seguidas para a mesma origem
+            std::vector<size_t> window{i};
+            std::string origin = urls[i].host + ":" + std::to_string(urls[i].port);
+            bool pipelinable = is_idempotent(requests[i].method) &&
+                               !pipelining_disabled.count(origin);
+            size_t j = i + 1;
+            while (pipelinable && j < requests.size() && window.size() < PIPELINE_DEPTH &&
+                   valid[j] && is_idempotent(requests[j].method) &&
+                   urls[j].host == urls[i].host && urls[j].port == urls[i].port) {
+                window.push_back(j++);
+            }
+            i = j;
+
+            size_t answered = window.size() > 1 ? pipeline(requests, urls, window, results) : 0;
+
+            // Servidor fechou a conexão (Connection: close) sem falhar: o restante
+            // da janela vai em um novo pipeline
+            if (answered > 0 && answered < window.size() && !pipelining_disabled.count(origin)) {
+                i = window[answered];
+                continue;
+            }
+
+            // Sem pipeline (ou o que sobrou de uma janela interrompida): sequencial
+            for (size_t w = answered; w < window.size(); w++) {
+                const BatchRequest& item = requests[window[w]];
+                auto start = std::chrono::steady_clock::now();
+                HTTPResponse response = request(item.method, item.url, item.body, item.headers);
+                auto latency = std::chrono::duration_cast<std::chrono::microseconds>(
+                    std::chrono::steady_clock::now() - start);
+                results[window[w]] = {std::move(response), latency, false};
+            }
+        }
+
+        return results;
+    }
 
-class HTTPClient {
 private:
-    std::string user_agent;
+    // RFC 7231, seção 4.2.2: só métodos idempotentes podem ser reenviados
+    // com segurança se o pipeline for interrompido
+    static bool is_idempotent(const std::string& method) {
+        return method == "GET" || method == "HEAD" || method == "PUT" ||
+               method == "DELETE" || method == "OPTIONS";
+    }
+
+    // RFC 7231, seção 4.2.1: métodos seguros (sem efeito no servidor)
+    static bool is_safe(const std::string& method) {
+        return method == "GET" || method == "HEAD" || method == "OPTIONS";
+    }
+
+    // Escreve toda a janela numa conexão e lê as respostas em ordem.
+    // Retorna quantas foram respondidas; as restantes ficam para o chamador.
+    size_t pipeline(const std::vector<BatchRequest>& requests, const std::vector<URL>& urls,
+                    const std::vector<size_t>& window, std::vector<BatchResult>& results) {
+        const URL& url = urls[window.front()];
+        std::string origin = url.host + ":" + std::to_string(url.port);
+
+        // Headers de toda a janela num buffer; corpos referenciados por iovec
+        std::string heads;
+        std::vector<size_t> head_ends;
+        for (size_t index : window) {
+            const BatchRequest& item = requests[index];
+            build_http_request(item.method, urls[index], item.body.size(), item.headers, heads,
+                               true);
+            head_ends.push_back(heads.size());
+        }
+
+        for (int attempt = 0; attempt < 2; attempt++) {
+            bool reused = true;
+            bool early_sent = false;
+            PhaseTrace trace;
+            trace.begin();
+            Connection conn = pool.acquire(url.host, url.port, url.protocol == "https");
+            if (!conn) {
+                reused = false;
+                conn = open_connection(url, {}, early_sent, trace);
+                if (!conn) {
+                    return 0;
+                }
+            }
+
+            std::vector<struct iovec> iov;
+            size_t head_start = 0;
+            for (size_t w = 0; w < window.size(); w++) {
+                iov.push_back({&heads[head_start], head_ends[w] - head_start});
+                const std::string& item_body = requests[window[w]].body;
+                if (!item_body.empty()) {
+                    iov.push_back({const_cast<char*>(item_body.data()), item_body.size()});
+                }
+                head_start = head_ends[w];
+            }
+
+            auto start = std::chrono::steady_clock::now();
+            if (!conn.write_iov(iov.data(), iov.size())) {
+                if (reused) {
+                    continue;
+                }
+                return 0;
+            }
+            // Cada resposta herda as fases comuns à janela; bytes e leituras são os dela
+            size_t iov_bytes = 0;
+            for (const struct iovec& part : iov) {
+                iov_bytes += part.iov_len;
+            }
+            trace.count_write(iov_bytes);
+            trace.mark(TracePhase::WRITE);
+
+            // Bytes lidos além de uma resposta pertencem à próxima
+            ReceiveBuffer carry;
+            size_t answered = 0;
+            bool failed = false;
+            bool keep_alive = false;
+            std::chrono::seconds server_timeout(0);
+            while (answered < window.size()) {
+                const BatchRequest& item = requests[window[answered]];
+                HTTPResponse response = receive_http_response(conn, item.method, keep_alive,
+                                                              server_timeout, nullptr, &carry,
+                                                              trace);
+                if (response.status_code == 0) {
+                    failed = true;
+                    break;
+                }
+
+                auto latency = std::chrono::duration_cast<std::chrono::microseconds>(
+                    std::chrono::steady_clock::now() - start);
+                results[window[answered]] = {std::move(response), latency, true};
+                answered++;
+
+                // Servidor vai fechar a conexão: o restante segue sequencial
+                if (!keep_alive) {
+                    break;
+                }
+            }
+
+            if (answered == window.size() && keep_alive && carry.empty()) {
+                pool.release(url.host, url.port, std::move(conn), server_timeout);
+            }
+            conn.reset();
+
+            // Conexão ociosa obsoleta: nada foi respondido, tenta uma nova
+            if (answered == 0 && reused) {
+                continue;
+            }
+
+            // Falha no meio do pipeline (e não um Connection: close): o servidor
+            // não suporta pipelining e a origem passa para o modo sequencial
+            if (failed) {
+                pipelining_disabled.insert(origin);
+            }
+            return answered;
+        }
+
+        return 0;
+    }
+
+    // Conexão nova: TCP e, em https, handshake TLS (retomando a sessão da
+    // origem, se houver). early vai como 0-RTT quando possível; early_sent
+    // indica se o servidor a aceitou.
+    Connection open_connection(const URL& url, std::string_view early, bool& early_sent,
+                               PhaseTrace& trace) {
+        early_sent = false;
+        bool secure = url.protocol == "https";
+#ifndef HTTP_WITH_TLS
+        (void)early;
+        if (secure) {
+            std::cerr << "HTTPS indisponível: compile com -DHTTP_WITH_TLS -lssl -lcrypto"
+                      << std::endl;
+            return Connection();
+        }
+#endif
+
+        Connection conn(create_socket(url.host, url.port, trace));
+        if (!conn || !secure) {
+            return conn;
+        }
+
+#ifdef HTTP_WITH_TLS
+        std::string error;
+        SSL* ssl = tls.handshake(conn.fd(), url.host, url.port, early, early_sent, error);
+        if (!ssl) {
+            std::cerr << "Erro TLS com " << url.host << ":" << url.port << ": " << error
+                      << std::endl;
+            return Connection();
+        }
+        conn.attach_tls(ssl);
+        trace.mark(TracePhase::TLS);
+        if (early_sent) {
+            trace.count_write(early.size());
+            trace.mark(TracePhase::WRITE);
+        }
+#endif
+        return conn;
+    }
+
+    int create_socket(const std::string& host, int port, PhaseTrace& trace) {
+        // Resolver nome do host (cache compartilhado, IPv4 e IPv6)
+        std::string error;
+        DNSResolver::Addresses addresses = DNSResolver::shared().resolve(host, port, &error);
+        if (addresses.empty()) {
+            std::cerr << error << std::endl;
+            return -1;
+        }
+        trace.mark(TracePhase::DNS);
+
+        // Conectar (Happy Eyeballs entre os endereços resolvidos)
+        int sock = happy_eyeballs_connect(addresses, std::chrono::seconds(10),
+                                          std::chrono::milliseconds(250), &error,
+                                          [this](int fd) { apply_tuning(fd, tuning); });
+        if (sock < 0) {
+            std::cerr << "Erro ao conectar com " << host << ":" << port << ": " << error << std::endl;
+            return -1;
+        }
+        trace.mark(TracePhase::CONNECT);
+
+        // Timeout de recepção
+        struct timeval timeout{5, 0}; // 5 segundos
+        setsockopt(sock, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout));
+
+        return sock;
+    }
+
+    // Serializa linha de requisição e headers em head. O buffer é reutilizado
+    // entre requisições (mantém a capacidade alocada).
+    void build_http_request(const std::string& method, const URL& url, size_t body_length,
+                            const std::map<std::string, std::string>& custom_headers,
+                            std::string& head, bool append = false) {
+        if (!append) {
+            head.clear();
+        }
+
+        // Linha de requisição
+        head.append(method).append(" ").append(url.path).append(url.query).append(" HTTP/1.1\r\n");
+
+        // Headers básicos
+        head.append("Host: ").append(url.host).append("\r\n");
+        head.append("User-Agent: ").append(user_agent).append("\r\n");
+
+        // Conexão persistente, salvo se o chamador definir o próprio Connection
+        bool has_connection_header = false;
+        bool has_encoding_header = false;
+        for (const auto& header : custom_headers) {
+            if (iequals(header.first, "Connection")) {
+                has_connection_header = true;
+            } else if (iequals(header.first, "Accept-Encoding")) {
+                has_encoding_header = true;
+            }
+        }
+        if (!has_connection_header) {
+            head.append("Connection: keep-alive\r\n");
+        }
+        if (accept_encoding && !has_encoding_header) {
+            head.append("Accept-Encoding: ").append(ContentDecoder::accept_encoding());
+            head.append("\r\n");
+        }
+
+        // Headers customizados
+        for (const auto& header : custom_headers) {
+            head.append(header.first).append(": ").append(header.second).append("\r\n");
+        }
+
+        // Content-Length se tiver body
+        if (body_length > 0) {
+            char digits[24];
+            auto result = std::to_chars(digits, digits + sizeof(digits), body_length);
+            head.append("Content-Length: ").append(digits, result.ptr).append("\r\n");
+        }
+
+        // Fim dos headers
+        head.append("\r\n");
+    }
+
+    // Headers e corpo saem juntos com sendmsg (corpo em memória) ou headers
+    // seguidos de sendfile (corpo em arquivo), sem copiar o corpo
+    bool send_request(Connection& conn, const std::string& head, const RequestBody& body) {
+        if (body.file_fd >= 0) {
+            // MSG_MORE: headers vão no mesmo segmento que o início do arquivo
+            return conn.write(head.data(), head.size(), MSG_MORE) &&
+                   conn.write_file(body.file_fd, body.file_offset, body.file_length);
+        }
+
+        struct iovec iov[2] = {
+            {const_cast<char*>(head.data()), head.size()},
+            {const_cast<char*>(body.data.data()), body.data.size()},
+        };
+        return conn.write_iov(iov, body.data.empty() ? 1 : 2);
+    }
+
+    // Recebe uma resposta com o parser incremental; o corpo é entregue a on_body
+    // (ou acumulado em response.body) conforme os segmentos chegam. Com carry,
+    // bytes já lidos são consumidos primeiro e o excedente (início da próxima
+    // resposta em pipeline) é devolvido nele. trace traz as fases até o envio;
+    // primeiro byte, fim do corpo e leituras são marcados em response.trace.
+    HTTPResponse receive_http_response(Connection& conn, const std::string& method,
+                                       bool& keep_alive, std::chrono::seconds& server_timeout,
+                                       const BodyCallback& on_body = nullptr,
+                                       ReceiveBuffer* carry = nullptr,
+                                       const PhaseTrace& trace = PhaseTrace(),
+                                       const HeadersCallback& on_headers = nullptr) {
+        HTTPResponse response;
+        response.trace = trace;
+        // Buffer do pool, do tamanho do SO_RCVBUF: uma leitura esvazia o socket
+        BufferPool::Lease buffer = BufferPool::shared().acquire(receive_buffer_size(conn.fd()));
+        keep_alive = false;
+        server_timeout = std::chrono::seconds(0);
+
+        HTTPResponseParser parser;
+        parser.reset(method == "HEAD");
+        parser.set_content_decoding(accept_encoding);
+        parser.on_status = [&](std::string_view version, int status_code,
+                               std::string_view status_text) {
+            response.version.assign(version);
+            response.status_code = status_code;
+            response.status_text.assign(status_text);
+        };
+        parser.on_header = [&](std::string_view name, std::string_view value) {
+            response.headers[std::string(name)].assign(value);
+        };
+        parser.on_trailer = [&](std::string_view name, std::string_view value) {
+            response.headers[std::string(name)].assign(value);
+        };
+        bool to_output = !on_body && body_output >= 0;
+        bool output_failed = false;
+        parser.on_headers_complete = [&]() {
+            response.content_length = parser.content_length();
+            // Corpo de tamanho conhecido: uma alocação só (limitada contra headers hostis)
+            if (!on_body && !to_output && response.content_length > 0) {
+                response.body.reserve(std::min<size_t>(response.content_length, 64 * 1024 * 1024));
+            }
+            if (on_headers) {
+                on_headers(response);
+            }
+        };
+        parser.on_body = [&](const char* data, size_t length) {
+            if (on_body) {
+                on_body(data, length);
+            } else if (to_output) {
+                output_failed = output_failed || !write_all(body_output, data, length);
+            } else {
+                response.body.append(data, length);
+            }
+        };
+        parser.on_message_complete = [&]() {
+            response.wire_length = parser.encoded_body_bytes();
+            response.decoded_length = parser.decoded_body_bytes();
+        };
+
+        bool trailing_data = false;
+        auto consume = [&](const char* data, size_t length) {
+            size_t consumed = parser.feed(data, length);
+            if (consumed < length) {
+                if (carry) {
+                    carry->append(data + consumed, length - consumed);
+                } else {
+                    // Dados além do fim da resposta: a conexão não está sincronizada
+                    trailing_data = true;
+                }
+            }
+        };
+
+        bool first_read = true;
+        if (carry && !carry->empty()) {
+            // O que sobrar fica em carry para a próxima resposta
+            response.trace.mark(TracePhase::FIRST_BYTE);
+            first_read = false;
+            carry->consume(parser.feed(carry->data(), carry->size()));
+        }
+
+        // splice só sem TLS e sem pipeline (carry: o excedente precisa passar pelo parser)
+        bool zero_copy = to_output && !conn.secure() && !carry && splice_capable(body_output);
+        while (!parser.complete() && !parser.failed() && !output_failed) {
+            if (zero_copy && parser.raw_body_remaining() > 0) {
+                size_t remaining = parser.raw_body_remaining();
+                size_t moved = splice_body(conn.fd(), body_output, remaining, response.trace,
+                                           output_failed);
+                parser.skip_body(moved);
+                if (moved < remaining) {
+                    parser.finish();
+                    break;
+                }
+                continue;
+            }
+
+            ssize_t bytes_received = conn.read(buffer.data(), buffer.size());
+            response.trace.count_read(std::max<ssize_t>(bytes_received, 0));
+            if (bytes_received <= 0) {
+                parser.finish();
+                break;
+            }
+            if (first_read) {
+                response.trace.mark(TracePhase::FIRST_BYTE);
+                first_read = false;
+            }
+
+            consume(buffer.data(), bytes_received);
+        }
+        response.trace.mark(TracePhase::TRANSFER);
+
+        if (output_failed) {
+            std::cerr << "Erro ao gravar o corpo: " << strerror(errno) << std::endl;
+            response.status_code = 0;
+            return response;
+        }
+        if (parser.failed()) {
+            std::cerr << parser.error() << std::endl;
+            response.status_code = 0;
+            return response;
+        }
+
+        keep_alive = parser.keep_alive() && !trailing_data;
+
+        // Keep-Alive: timeout=N informa quanto tempo o servidor mantém a conexão
+        if (const std::string* ka = find_header(response, "Keep-Alive")) {
+            size_t pos = ka->find("timeout=");
+            if (pos != std::string::npos) {
+                int seconds = std::atoi(ka->c_str() + pos + 8);
+                // Margem de 1s para não reutilizar uma conexão prestes a expirar
+                server_timeout = std::chrono::seconds(seconds > 1 ? seconds - 1 : 0);
+                if (seconds <= 1) {
+                    keep_alive = false;
+                }
+            }
+        }
+
+        return response;
+    }
+
+    // Destinos em que splice grava: pipe (direto do socket) ou arquivo comum.
+    // O_APPEND não é aceito pelo splice.
+    static bool splice_capable(int fd) {
+        struct stat info{};
+        if (fstat(fd, &info) < 0 || (fcntl(fd, F_GETFL) & O_APPEND)) {
+            return false;
+        }
+        return S_ISFIFO(info.st_mode) || S_ISREG(info.st_mode);
+    }
+
+    // Move até length bytes do socket para fd sem passar pelo espaço do
+    // usuário: direto se fd for um pipe, senão socket -> pipe -> fd.
+    // Retorna os bytes entregues; failed indica erro ao gravar em fd.
+    static size_t splice_body(int sock, int fd, size_t length, PhaseTrace& trace, bool& failed) {
+        struct stat info{};
+        bool direct = fstat(fd, &info) == 0 && S_ISFIFO(info.st_mode);
+        int pipe_fds[2] = {-1, -1};
+        if (!direct && pipe2(pipe_fds, O_CLOEXEC) < 0) {
+            failed = true;
+            return 0;
+        }
+
+        size_t delivered = 0;
+        while (delivered < length && !failed) {
+            ssize_t in = splice(sock, nullptr, direct ? fd : pipe_fds[1], nullptr,
+                                std::min<size_t>(length - delivered, 1024 * 1024),
+                                SPLICE_F_MOVE | SPLICE_F_MORE);
+            trace.count_read(std::max<ssize_t>(in, 0));
+            if (in < 0 && errno == EINTR) {
+                continue;
+            }
+            if (in <= 0) {
+                // EOF ou timeout de recepção: o parser acusa o corpo incompleto
+                break;
+            }
+            if (direct) {
+                delivered += in;
+                continue;
+            }
+
+            // Esvaziar o pipe no arquivo
+            while (in > 0) {
+                ssize_t out = splice(pipe_fds[0], nullptr, fd, nullptr, in,
+                                     SPLICE_F_MOVE | SPLICE_F_MORE);
+                if (out < 0 && errno == EINTR) {
+                    continue;
+                }
+                if (out <= 0) {
+                    failed = true;
+                    break;
+                }
+                in -= out;
+                delivered += out;
+            }
+        }
+
+        if (!direct) {
+            close(pipe_fds[0]);
+            close(pipe_fds[1]);
+        }
+        return delivered;
+    }
+
+    // Nomes de headers não diferenciam maiúsculas/minúsculas
+    static const std::string* find_header(const HTTPResponse& response, const std::string& name) {
+        for (const auto& header : response.headers) {
+            if (iequals(header.first, name)) {
+                return &header.second;
+            }
+        }
+        return nullptr;
+    }
+};
 
+
+// Motor assíncrono baseado em epoll: executa muitas requisições em sockets
+// não bloqueantes a partir de um único event loop. Reaproveita a montagem de
+// requisições do HTTPClient, o HTTPResponseParser e o tipo HTTPResponse.
+class AsyncHTTPEngine {
 public:
-    HTTPClient() : user_agent("CustomHTTPClient/1.0") {}
+    using HTTPResponse = HTTPClient::HTTPResponse;
+    // Chamado quando a requisição termina; error vazio indica sucesso
+    using Completion = std::function<void(HTTPResponse& response, const std::string& error)>;
+
+    explicit AsyncHTTPEngine(HTTPClient& client, size_t max_in_flight = 256,
+                             DNSResolver& resolver = DNSResolver::shared())
+        : client(client), resolver(resolver), max_in_flight(max_in_flight ? max_in_flight : 1),
+          timeout(std::chrono::seconds(5)), next_id(1),
+          resolutions(std::make_shared<ResolutionQueue>()) {
+        epoll_fd = epoll_create1(EPOLL_CLOEXEC);
+        if (epoll_fd < 0) {
+            std::cerr << "Erro ao criar epoll: " << strerror(errno) << std::endl;
+            return;
+        }
 
-    struct HTTPResponse {
-        std::string version;
-        int status_code;
-        std::string status_text;
-        std::map<std::string, std::string> headers;
-        std::string body;
-        size_t content_length;
+        // Resoluções assíncronas concluídas acordam o loop pelo eventfd
+        struct epoll_event ev{};
+        ev.events = EPOLLIN;
+        ev.data.u64 = RESOLVER_EVENT;
+        epoll_ctl(epoll_fd, EPOLL_CTL_ADD, resolutions->event_fd, &ev);
+    }
+
+    ~AsyncHTTPEngine() {
+        for (auto& entry : active) {
+            if (entry.second->fd >= 0) {
+                close(entry.second->fd);
+            }
+        }
+        for (auto& entry : idle) {
+            for (int fd : entry.second) {
+                close(fd);
+            }
+        }
+        if (epoll_fd >= 0) {
+            close(epoll_fd);
+        }
+    }
+
+    AsyncHTTPEngine(const AsyncHTTPEngine&) = delete;
+    AsyncHTTPEngine& operator=(const AsyncHTTPEngine&) = delete;
+
+    // Tempo máximo de cada requisição (conexão + envio + resposta)
+    void set_timeout(std::chrono::milliseconds value) {
+        timeout = value;
+    }
+
+    // Enfileira uma requisição; ela começa quando houver vaga no run()
+    void submit(const std::string& method, const std::string& url_str, Completion done,
+                const std::string& body = "",
+                const std::map<std::string, std::string>& custom_headers = {}) {
+        submit_at(std::chrono::steady_clock::time_point(), method, url_str, std::move(done), body,
+                  custom_headers);
+    }
+
+    // Como submit, mas a requisição só começa a partir de start. A fila é
+    // FIFO: submeter em ordem crescente de start (ex.: taxa fixa).
+    void submit_at(std::chrono::steady_clock::time_point start, const std::string& method,
+                   const std::string& url_str, Completion done, const std::string& body = "",
+                   const std::map<std::string, std::string>& custom_headers = {}) {
+        auto transfer = std::make_unique<Transfer>();
+        transfer->method = method;
+        transfer->done = std::move(done);
+        transfer->not_before = start;
+
+        // A falha é entregue por run(): chamar done aqui deixaria um callback que
+        // submete a próxima requisição recursar sem voltar ao loop
+        if (!transfer->url.parse(url_str)) {
+            rejected.emplace_back(std::move(transfer), "URL inválida");
+            return;
+        }
+        // Sockets não bloqueantes em texto puro; HTTPS passa pelo HTTPClient
+        if (transfer->url.protocol == "https") {
+            rejected.emplace_back(std::move(transfer),
+                                  "HTTPS não suportado em paralelo (use --pipeline)");
+            return;
+        }
+        client.build_http_request(method, transfer->url, body.size(), custom_headers, transfer->head);
+        transfer->body = body;
+        pending.push_back(std::move(transfer));
+    }
+
+    // Bytes escritos e lidos nos sockets (headers incluídos)
+    uint64_t bytes_sent() const { return sent_bytes; }
+    uint64_t bytes_received() const { return received_bytes; }
+
+    // Processa eventos até todas as requisições terminarem (inclusive as
+    // submetidas pelos callbacks de conclusão)
+    void run() {
+        std::vector<struct epoll_event> events(256);
+
+        while (true) {
+            finish_rejected();
+            start_pending();
+            if (active.empty() && pending.empty() && rejected.empty()) {
+                break;
+            }
+            if (!rejected.empty()) {
+                continue; // Callbacks das recusadas submeteram outras recusadas
+            }
+
+            int wait_ms = next_timeout_ms();
+            int ready = epoll_wait(epoll_fd, events.data(), static_cast<int>(events.size()), wait_ms);
+            if (ready < 0) {
+                if (errno == EINTR) {
+                    continue;
+                }
+                std::cerr << "Erro no epoll_wait: " << strerror(errno) << std::endl;
+                break;
+            }
+
+            for (int i = 0; i < ready; i++) {
+                if (events[i].data.u64 == RESOLVER_EVENT) {
+                    handle_resolutions();
+                    continue;
+                }
+                auto it = active.find(events[i].data.u64);
+                if (it != active.end()) {
+                    handle_event(*it->second, events[i].events);
+                }
+            }
+
+            expire_timeouts();
+        }
+    }
+
+private:
+    enum class Phase { RESOLVING, CONNECTING, SENDING, RECEIVING };
+
+    // Identificador reservado para o eventfd das resoluções (ids começam em 1)
+    static constexpr uint64_t RESOLVER_EVENT = 0;
+
+    // Entrega resultados das threads do resolvedor para o event loop. É
+    // compartilhada com os callbacks, que podem terminar depois do motor.
+    struct ResolutionQueue {
+        struct Result {
+            uint64_t id;
+            DNSResolver::Addresses addresses;
+            std::string error;
+        };
+
+        int event_fd;
+        std::mutex mutex;
+        std::vector<Result> results;
+
+        ResolutionQueue() : event_fd(eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC)) {}
+        ~ResolutionQueue() {
+            close(event_fd);
+        }
 
-        HTTPResponse() : status_code(0), content_length(0) {}
+        void push(Result result) {
+            {
+                std::lock_guard<std::mutex> lock(mutex);
+                results.push_back(std::move(result));
+            }
+            uint64_t one = 1;
+            ssize_t ignored = write(event_fd, &one, sizeof(one));
+            (void)ignored;
+        }
     };
 
-    struct URL {
-        std::string protocol;
-        std::string host;
-        int port;
-        std::string path;
-        std::string query;
+    struct Transfer {
+        uint64_t id = 0;
+        int fd = -1;
+        bool reused = false;
+        bool received_any = false;
+        Phase phase = Phase::RESOLVING;
+        DNSResolver::Addresses addresses;
+        size_t next_address = 0;
+        std::string method;
+        HTTPClient::URL url;
+        std::string head;
+        std::string body;
+        size_t sent = 0; // Bytes de head + body já enviados
+        HTTPResponseParser parser;
+        HTTPResponse response;
+        Completion done;
+        std::chrono::steady_clock::time_point not_before; // Início agendado (submit_at)
+        std::chrono::steady_clock::time_point deadline;
+    };
 
-        URL() : port(80) {}
+    HTTPClient& client;
+    DNSResolver& resolver;
+    int epoll_fd;
+    size_t max_in_flight;
+    std::chrono::milliseconds timeout;
+    uint64_t next_id;
+    std::shared_ptr<ResolutionQueue> resolutions;
+
+    std::deque<std::unique_ptr<Transfer>> pending;
+    // Recusadas no submit (URL inválida, https), com o erro a entregar
+    std::deque<std::pair<std::unique_ptr<Transfer>, std::string>> rejected;
+    std::unordered_map<uint64_t, std::unique_ptr<Transfer>> active;
+    std::set<std::pair<std::chrono::steady_clock::time_point, uint64_t>> deadlines;
+    // Conexões keep-alive ociosas por host:porta (fora do epoll)
+    std::map<std::string, std::vector<int>> idle;
+    // Buffer de recepção compartilhado pelas transferências (loop de uma thread)
+    BufferPool::Lease receive_buffer;
+    uint64_t sent_bytes = 0;
+    uint64_t received_bytes = 0;
+
+    static std::string key(const HTTPClient::URL& url) {
+        return url.host + ":" + std::to_string(url.port);
+    }
+
+    void start_pending() {
+        auto now = std::chrono::steady_clock::now();
+        while (!pending.empty() && active.size() < max_in_flight &&
+               pending.front()->not_before <= now) {
+            std::unique_ptr<Transfer> transfer = std::move(pending.front());
+            pending.pop_front();
+
+            Transfer& t = *transfer;
+            t.id = next_id++;
+            t.deadline = now + timeout;
+            setup_parser(t);
+            t.response.trace.begin();
+
+            std::string error = open_connection(t);
+            if (!error.empty()) {
+                finish_pending(t, error);
+                continue;
+            }
+
+            deadlines.insert({t.deadline, t.id});
+            active[t.id] = std::move(transfer);
+        }
+    }
+
+    void setup_parser(Transfer& t) {
+        t.response = HTTPResponse();
+        t.parser.reset(t.method == "HEAD");
+        t.parser.set_content_decoding(client.accept_encoding);
+        t.parser.on_status = [&t](std::string_view version, int status_code,
+                                  std::string_view status_text) {
+            t.response.version.assign(version);
+            t.response.status_code = status_code;
+            t.response.status_text.assign(status_text);
+        };
+        t.parser.on_header = [&t](std::string_view name, std::string_view value) {
+            t.response.headers[std::string(name)].assign(value);
+        };
+        t.parser.on_trailer = t.parser.on_header;
+        t.parser.on_headers_complete = [&t]() {
+            t.response.content_length = t.parser.content_length();
+        };
+        t.parser.on_body = [&t](const char* data, size_t length) {
+            t.response.body.append(data, length);
+        };
+        t.parser.on_message_complete = [&t]() {
+            t.response.wire_length = t.parser.encoded_body_bytes();
+            t.response.decoded_length = t.parser.decoded_body_bytes();
+        };
+    }
+
+    // Reaproveita uma conexão ociosa ou inicia a resolução do host
+    std::string open_connection(Transfer& t) {
+        auto it = idle.find(key(t.url));
+        if (it != idle.end() && !it->second.empty()) {
+            t.fd = it->second.back();
+            it->second.pop_back();
+            t.reused = true;
+            t.phase = Phase::SENDING;
+            return watch(t, EPOLLOUT);
+        }
+
+        t.reused = false;
+        t.phase = Phase::RESOLVING;
+        std::weak_ptr<ResolutionQueue> queue = resolutions;
+        uint64_t id = t.id;
+        resolver.resolve_async(t.url.host, t.url.port,
+                               [queue, id](const DNSResolver::Addresses& addresses,
+                                           const std::string& error) {
+            if (auto target = queue.lock()) {
+                target->push({id, addresses, error});
+            }
+        });
+        return "";
+    }
+
+    void handle_resolutions() {
+        uint64_t counter;
+        ssize_t ignored = read(resolutions->event_fd, &counter, sizeof(counter));
+        (void)ignored;
+
+        std::vector<ResolutionQueue::Result> results;
+        {
+            std::lock_guard<std::mutex> lock(resolutions->mutex);
+            results.swap(resolutions->results);
+        }
+
+        for (auto& result : results) {
+            auto it = active.find(result.id);
+            if (it == active.end() || it->second->phase != Phase::RESOLVING) {
+                continue; // Já terminou (ex: timeout)
+            }
+
+            Transfer& t = *it->second;
+            if (result.addresses.empty()) {
+                finish(t, result.error);
+                continue;
+            }
+            t.response.trace.mark(TracePhase::DNS);
+            t.addresses = interleave_families(result.addresses);
+            t.next_address = 0;
+            connect_next(t);
+        }
+    }
+
+    // connect não bloqueante para o próximo endereço resolvido
+    void connect_next(Transfer& t) {
+        std::string error = "Erro ao conectar com " + t.url.host;
+
+        while (t.next_address < t.addresses.size()) {
+            const ResolvedAddress& address = t.addresses[t.next_address++];
+            t.fd = socket(address.family, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+            if (t.fd < 0) {
+                error = "Erro ao criar socket";
+                continue;
+            }
+            apply_tuning(t.fd, client.tuning);
+
+            int rc = ::connect(t.fd, reinterpret_cast<const sockaddr*>(&address.addr),
+                               address.length);
+            if (rc < 0 && errno != EINPROGRESS) {
+                error = "Erro ao conectar com " + t.url.host + ": " + strerror(errno);
+                close(t.fd);
+                t.fd = -1;
+                continue;
+            }
+
+            t.phase = rc == 0 ? Phase::SENDING : Phase::CONNECTING;
+            if (rc == 0) {
+                t.response.trace.mark(TracePhase::CONNECT);
+            }
+            error = watch(t, EPOLLOUT);
+            if (error.empty()) {
+                return;
+            }
+        }
+
+        finish(t, error);
+    }
+
+    std::string watch(Transfer& t, uint32_t events) {
+        struct epoll_event ev{};
+        ev.events = events;
+        ev.data.u64 = t.id;
+        if (epoll_ctl(epoll_fd, EPOLL_CTL_ADD, t.fd, &ev) < 0) {
+            return std::string("Erro no epoll_ctl: ") + strerror(errno);
+        }
+        return "";
+    }
 
-        bool parse(const std::string& url) {
-            // Regex para parsing de URL
-            std::regex url_regex(R"((https?)://([^:/]+)(?::(\d+))?(/[^?#]*)?(\?[^#]*)?)");
-            std::smatch matches;
+    void rearm(Transfer& t, uint32_t events) {
+        struct epoll_event ev{};
+        ev.events = events;
+        ev.data.u64 = t.id;
+        epoll_ctl(epoll_fd, EPOLL_CTL_MOD, t.fd, &ev);
+    }
 
-            if (!std::regex_match(url, matches, url_regex)) {
-                std::cerr << "URL inválida: " << url << std::endl;
-                return false;
+    void handle_event(Transfer& t, uint32_t events) {
+        if (t.phase == Phase::CONNECTING) {
+            int error = 0;
+            socklen_t len = sizeof(error);
+            getsockopt(t.fd, SOL_SOCKET, SO_ERROR, &error, &len);
+            if (error != 0) {
+                // Tenta o próximo endereço (ex: IPv6 falhou, IPv4 disponível)
+                epoll_ctl(epoll_fd, EPOLL_CTL_DEL, t.fd, nullptr);
+                close(t.fd);
+                t.fd = -1;
+                if (t.next_address < t.addresses.size()) {
+                    connect_next(t);
+                } else {
+                    finish(t, "Erro ao conectar com " + t.url.host + ": " + strerror(error));
+                }
+                return;
             }
+            t.phase = Phase::SENDING;
+            t.response.trace.mark(TracePhase::CONNECT);
+        }
 
-            protocol = matches[1];
-            host = matches[2];
+        if (t.phase == Phase::SENDING) {
+            if (events & EPOLLERR) {
+                retry_or_finish(t, "Erro ao enviar requisição");
+                return;
+            }
+            size_t total = t.head.size() + t.body.size();
+            while (t.sent < total) {
+                // Headers e corpo em um único sendmsg, retomando após escrita parcial
+                struct iovec iov[2];
+                size_t count = 0;
+                if (t.sent < t.head.size()) {
+                    iov[count++] = {&t.head[t.sent], t.head.size() - t.sent};
+                }
+                size_t body_sent = t.sent > t.head.size() ? t.sent - t.head.size() : 0;
+                if (body_sent < t.body.size()) {
+                    iov[count++] = {&t.body[body_sent], t.body.size() - body_sent};
+                }
+                struct msghdr msg{};
+                msg.msg_iov = iov;
+                msg.msg_iovlen = count;
 
-            // Porta padrão baseada no protocolo
-            if (matches[3].matched && !matches[3].str().empty()) {
-                port = std::stoi(matches[3]);
-            } else {
-                port = (protocol == "https") ? 443 : 80;
+                ssize_t n = sendmsg(t.fd, &msg, MSG_NOSIGNAL);
+                if (n < 0 && errno == EINTR) {
+                    continue;
+                }
+                if (n < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) {
+                    return; // Aguarda o próximo EPOLLOUT
+                }
+                if (n <= 0) {
+                    retry_or_finish(t, "Erro ao enviar requisição");
+                    return;
+                }
+                t.sent += n;
+                sent_bytes += n;
+                t.response.trace.count_write(n);
             }
+            t.phase = Phase::RECEIVING;
+            t.response.trace.mark(TracePhase::WRITE);
+            rearm(t, EPOLLIN);
+            return;
+        }
 
-            path = matches[4].matched ? matches[4].str() : "/";
-            query = matches[5].matched ? matches[5].str() : "";
+        // RECEIVING: consome tudo o que estiver disponível. Um único buffer do
+        // pool serve todas as conexões do loop.
+        if (receive_buffer.size() == 0) {
+            receive_buffer = BufferPool::shared().acquire(receive_buffer_size(t.fd, 16384));
+        }
+        char* buffer = receive_buffer.data();
+        while (true) {
+            ssize_t n = recv_some(t.fd, buffer, receive_buffer.size());
+            t.response.trace.count_read(std::max<ssize_t>(n, 0));
+            if (n < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) {
+                return;
+            }
+            if (n <= 0) {
+                t.parser.finish();
+                if (!t.received_any) {
+                    retry_or_finish(t, t.parser.error());
+                    return;
+                }
+                break;
+            }
 
-            return true;
+            if (!t.received_any) {
+                t.response.trace.mark(TracePhase::FIRST_BYTE);
+            }
+            t.received_any = true;
+            received_bytes += n;
+            size_t consumed = t.parser.feed(buffer, n);
+            if (t.parser.complete() || t.parser.failed()) {
+                // Bytes além do fim da resposta: conexão dessincronizada
+                bool reusable = consumed == static_cast<size_t>(n) && t.parser.keep_alive();
+                finish(t, t.parser.failed() ? t.parser.error() : "", reusable);
+                return;
+            }
         }
-    };
 
-    HTTPResponse request(const std::string& method, const std::string& url_str,
-                        const std::string& body = "",
-                        const std::map<std::string, std::string>& custom_headers = {}) {
-        HTTPResponse response;
+        finish(t, t.parser.failed() ? t.parser.error() : "");
+    }
 
-        // Parse da URL
-        URL url;
-        if (!url.parse(url_str)) {
-            return response;
+    // Conexão keep-alive fechada pelo servidor antes de responder: tenta de novo
+    void retry_or_finish(Transfer& t, const std::string& error) {
+        if (!t.reused || t.received_any) {
+            finish(t, error);
+            return;
         }
 
-        // Criar socket
-        int sock = create_socket(url.host, url.port);
-        if (sock < 0) {
-            return response;
+        epoll_ctl(epoll_fd, EPOLL_CTL_DEL, t.fd, nullptr);
+        close(t.fd);
+        t.fd = -1;
+        t.sent = 0;
+        // Nova tentativa: o trace continua desde o início original
+        PhaseTrace trace = t.response.trace;
+        setup_parser(t);
+        t.response.trace = trace;
+
+        // As demais conexões ociosas para o mesmo host provavelmente também expiraram
+        auto it = idle.find(key(t.url));
+        if (it != idle.end()) {
+            for (int fd : it->second) {
+                close(fd);
+            }
+            idle.erase(it);
         }
 
-        // Construir requisição HTTP
-        std::string request = build_http_request(method, url, body, custom_headers);
+        std::string connect_error = open_connection(t);
+        if (!connect_error.empty()) {
+            finish(t, connect_error);
+        }
+    }
 
-        // Enviar requisição
-        if (send(sock, request.c_str(), request.length(), 0) < 0) {
-            std::cerr << "Erro ao enviar requisição" << std::endl;
-            close(sock);
-            return response;
+    void finish(Transfer& t, const std::string& error, bool reusable = false) {
+        uint64_t id = t.id;
+        if (t.fd >= 0) {
+            epoll_ctl(epoll_fd, EPOLL_CTL_DEL, t.fd, nullptr);
+            if (reusable && error.empty()) {
+                idle[key(t.url)].push_back(t.fd);
+            } else {
+                close(t.fd);
+            }
+            t.fd = -1;
         }
 
-        // Receber resposta
-        response = receive_http_response(sock);
-        close(sock);
+        if (!error.empty()) {
+            t.response.status_code = 0;
+        }
+        if (t.received_any) {
+            t.response.trace.mark(TracePhase::TRANSFER);
+        }
+        if (t.done) {
+            t.done(t.response, error);
+        }
 
-        return response;
+        deadlines.erase({t.deadline, id});
+        active.erase(id);
     }
 
-private:
-    int create_socket(const std::string& host, int port) {
-        // Resolver nome do host
-        struct hostent* server = gethostbyname(host.c_str());
-        if (!server) {
-            std::cerr << "Erro ao resolver host: " << host << std::endl;
-            return -1;
+    void finish_rejected() {
+        std::deque<std::pair<std::unique_ptr<Transfer>, std::string>> batch;
+        batch.swap(rejected);
+        for (auto& entry : batch) {
+            finish_pending(*entry.first, entry.second);
         }
+    }
 
-        // Criar socket
-        int sock = socket(AF_INET, SOCK_STREAM, 0);
-        if (sock < 0) {
-            std::cerr << "Erro ao criar socket" << std::endl;
-            return -1;
+    // Requisição que falhou antes de entrar no event loop
+    void finish_pending(Transfer& t, const std::string& error) {
+        if (t.fd >= 0) {
+            close(t.fd);
+            t.fd = -1;
         }
+        t.response.status_code = 0;
+        if (t.done) {
+            t.done(t.response, error);
+        }
+    }
 
-        // Configurar endereço do servidor
-        struct sockaddr_in server_addr{};
-        server_addr.sin_family = AF_INET;
-        server_addr.sin_port = htons(port);
-        memcpy(&server_addr.sin_addr, server->h_addr, server->h_length);
-
-        // Conectar
-        if (connect(sock, (struct sockaddr*)&server_addr, sizeof(server_addr)) < 0) {
-            std::cerr << "Erro ao conectar com " << host << ":" << port << std::endl;
-            close(sock);
+    // Até o próximo timeout ou o próximo início agendado que tenha vaga
+    int next_timeout_ms() const {
+        std::chrono::steady_clock::time_point next = std::chrono::steady_clock::time_point::max();
+        if (!deadlines.empty()) {
+            next = deadlines.begin()->first;
+        }
+        if (!pending.empty() && active.size() < max_in_flight) {
+            next = std::min(next, pending.front()->not_before);
+        }
+        if (next == std::chrono::steady_clock::time_point::max()) {
             return -1;
         }
+        // Arredonda para cima: acordar antes do horário gira o loop à toa
+        auto remaining = std::chrono::ceil<std::chrono::milliseconds>(
+            next - std::chrono::steady_clock::now());
+        return remaining.count() > 0 ? static_cast<int>(remaining.count()) : 0;
+    }
 
-        // Timeout de recepção
-        struct timeval timeout{5, 0}; // 5 segundos
-        setsockopt(sock, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout));
+    void expire_timeouts() {
+        auto now = std::chrono::steady_clock::now();
+        while (!deadlines.empty() && deadlines.begin()->first <= now) {
+            uint64_t id = deadlines.begin()->second;
+            auto it = active.find(id);
+            if (it == active.end()) {
+                deadlines.erase(deadlines.begin());
+                continue;
+            }
+            finish(*it->second, "Timeout na requisição para " + it->second->url.host);
+        }
+    }
+};
 
-        return sock;
+// --- Benchmark e fuzz diferencial do parser (--bench-parser) ---
+// Compara o parser manual com a implementação anterior baseada em std::regex.
+// Primeiro verifica se os dois concordam sobre um corpus de entradas (sementes
+// + mutações aleatórias determinísticas) e depois mede o custo de cada um.
+namespace legacy_regex {
+
+struct URLParts {
+    std::string protocol, host, port, path, query;
+};
+
+bool parse_url(const std::string& url, URLParts& out) {
+    std::regex url_regex(R"((https?)://([^:/]+)(?::(\d+))?(/[^?#]*)?(\?[^#]*)?)");
+    std::smatch matches;
+    if (!std::regex_match(url, matches, url_regex)) {
+        return false;
     }
+    out.protocol = matches[1];
+    out.host = matches[2];
+    out.port = matches[3].matched ? matches[3].str() : "";
+    out.path = matches[4].matched ? matches[4].str() : "";
+    out.query = matches[5].matched ? matches[5].str() : "";
+    return true;
+}
 
-    std::string build_http_request(const std::string& method, const URL& url,
-                                  const std::string& body,
-                                  const std::map<std::string, std::string>& custom_headers) {
-        std::stringstream request;
+bool parse_header_line(const std::string& line, std::string& key, std::string& value) {
+    size_t colon_pos = line.find(':');
+    if (colon_pos == std::string::npos) {
+        return false;
+    }
+    key = std::regex_replace(line.substr(0, colon_pos), std::regex("^\\s+|\\s+$"), "");
+    value = std::regex_replace(line.substr(colon_pos + 1), std::regex("^\\s+|\\s+$"), "");
+    return true;
+}
 
-        // Linha de requisição
-        request << method << " " << url.path << url.query << " HTTP/1.1\r\n";
+void parse_status_line(const std::string& line, std::string& version, int& status_code,
+                       std::string& status_text) {
+    std::istringstream ss(line);
+    ss >> version >> status_code;
+    std::getline(ss, status_text);
+    status_text = std::regex_replace(status_text, std::regex("^\\s+|\\s+$"), "");
+}
 
-        // Headers básicos
-        request << "Host: " << url.host << "\r\n";
-        request << "User-Agent: " << user_agent << "\r\n";
-        request << "Connection: close\r\n";
+} // namespace legacy_regex
+
+const std::vector<std::string> URL_CORPUS = {
+    "http://httpbin.org/get",
+    "https://example.com",
+    "http://localhost:8080/",
+    "http://127.0.0.1:80/path/to/resource?x=1&y=2",
+    "https://api.example.com:8443/v1/items?page=2",
+    "http://host?query/with:colon",
+    "http://a?b:c",
+    "http://a?b#c",
+    "http://host:/x",
+    "http://host:12ab/",
+    "http://host/path#fragment",
+    "http:///nohost",
+    "ftp://example.com/",
+    "HTTP://example.com/",
+    "https://",
+    "http://h:65535",
+    "http://[::1]:8080/",
+    "http://user@host/p",
+    "http://host/a?b?c",
+    "http://h/%20space?q=%41",
+};
 
-        // Headers customizados
-        for (const auto& header : custom_headers) {
-            request << header.first << ": " << header.second << "\r\n";
-        }
+const std::vector<std::string> HEADER_CORPUS = {
+    "Content-Length: 348",
+    "Content-Type:application/json",
+    "  X-Padded  :   value with spaces  \t",
+    "Set-Cookie: a=b; Path=/; HttpOnly",
+    "NoColon",
+    ":empty-name",
+    "Empty-Value:",
+    "Multi: a: b: c",
+    "\tTabbed:\tv\t",
+    "Date: Wed, 14 Oct 2026 04:54:45 GMT",
+};
 
-        // Content-Length se tiver body
-        if (!body.empty()) {
-            request << "Content-Length: " << body.length() << "\r\n";
+void run_parser_benchmark(int iterations) {
+    std::mt19937 rng(12345);
+    const std::string alphabet = ":/?#@[]0123456789aZ% \t.-";
+
+    auto mutate = [&](std::string input) {
+        int edits = 1 + rng() % 3;
+        for (int e = 0; e < edits; e++) {
+            size_t pos = input.empty() ? 0 : rng() % (input.size() + 1);
+            char c = alphabet[rng() % alphabet.size()];
+            switch (rng() % 3) {
+            case 0: input.insert(input.begin() + pos, c); break;
+            case 1: if (pos < input.size()) input.erase(pos, 1); break;
+            default: if (pos < input.size()) input[pos] = c; break;
+            }
         }
+        return input;
+    };
 
-        // Fim dos headers
-        request << "\r\n";
+    // Fuzz diferencial: as duas implementações devem concordar
+    std::vector<std::string> urls = URL_CORPUS;
+    std::vector<std::string> header_lines = HEADER_CORPUS;
+    for (int i = 0; i < 2000; i++) {
+        urls.push_back(mutate(URL_CORPUS[rng() % URL_CORPUS.size()]));
+        header_lines.push_back(mutate(HEADER_CORPUS[rng() % HEADER_CORPUS.size()]));
+    }
 
-        // Body
-        if (!body.empty()) {
-            request << body;
+    size_t mismatches = 0;
+    for (const auto& url : urls) {
+        legacy_regex::URLParts expected;
+        URLView view;
+        bool legacy_ok = legacy_regex::parse_url(url, expected);
+        bool manual_ok = parse_url_view(url, view);
+        if (legacy_ok != manual_ok ||
+            (legacy_ok && (expected.protocol != view.protocol || expected.host != view.host ||
+                           expected.port != view.port || expected.path != view.path ||
+                           expected.query != view.query))) {
+            std::cout << "Divergência na URL: " << url << "\n";
+            mismatches++;
+        }
+    }
+    for (const auto& line : header_lines) {
+        std::string expected_key, expected_value;
+        std::string_view key, value;
+        bool legacy_ok = legacy_regex::parse_header_line(line, expected_key, expected_value);
+        bool manual_ok = HTTPResponseParser::parse_header_line(line, key, value);
+        if (legacy_ok != manual_ok ||
+            (legacy_ok && (expected_key != key || expected_value != value))) {
+            std::cout << "Divergência no header: " << line << "\n";
+            mismatches++;
         }
-
-        return request.str();
     }
+    std::cout << "Fuzz diferencial: " << urls.size() << " URLs, " << header_lines.size()
+              << " headers, " << mismatches << " divergências\n";
+
+    // Micro-benchmark
+    auto measure = [&](const char* name, auto&& body) {
+        auto start = std::chrono::steady_clock::now();
+        size_t checksum = 0;
+        for (int i = 0; i < iterations; i++) {
+            checksum += body();
+        }
+        auto end = std::chrono::steady_clock::now();
+        double ns = std::chrono::duration<double, std::nano>(end - start).count() / iterations;
+        std::cout << std::left << std::setw(28) << name << std::right << std::fixed
+                  << std::setprecision(1) << std::setw(10) << ns << " ns/op"
+                  << "  (checksum " << checksum << ")\n";
+        return ns;
+    };
 
-    HTTPResponse receive_http_response(int sock) {
-        HTTPResponse response;
-        char buffer[4096];
-        std::string raw_response;
+    const std::string url = "https://api.example.com:8443/v1/items?page=2&limit=50";
+    const std::string status = "HTTP/1.1 200 OK";
+    const std::string header = "Content-Type:   application/json; charset=utf-8  ";
+
+    std::cout << "\nIterações: " << iterations << "\n";
+    double legacy_url = measure("URL (regex)", [&]() {
+        legacy_regex::URLParts parts;
+        return legacy_regex::parse_url(url, parts) ? parts.host.size() : 0;
+    });
+    double manual_url = measure("URL (manual)", [&]() {
+        URLView view;
+        return parse_url_view(url, view) ? view.host.size() : 0;
+    });
+    double legacy_status = measure("Linha de status (regex)", [&]() {
+        std::string version, text;
+        int code = 0;
+        legacy_regex::parse_status_line(status, version, code, text);
+        return static_cast<size_t>(code);
+    });
+    double manual_status = measure("Linha de status (manual)", [&]() {
+        std::string_view version, text;
+        int code = 0;
+        HTTPResponseParser::parse_status_line(status, version, code, text);
+        return static_cast<size_t>(code);
+    });
+    double legacy_header = measure("Header (regex)", [&]() {
+        std::string key, value;
+        legacy_regex::parse_header_line(header, key, value);
+        return value.size();
+    });
+    double manual_header = measure("Header (manual)", [&]() {
+        std::string_view key, value;
+        HTTPResponseParser::parse_header_line(header, key, value);
+        return value.size();
+    });
+
+    std::cout << "\nGanho: URL " << std::setprecision(1) << legacy_url / manual_url
+              << "x, status " << legacy_status / manual_status
+              << "x, header " << legacy_header / manual_header << "x\n";
+}
 
-        // Receber dados até conexão fechar
-        while (true) {
-            ssize_t bytes_received = recv(sock, buffer, sizeof(buffer) - 1, 0);
-            if (bytes_received <= 0) {
-                break;
-            }
+void print_usage() {
+    std::cout << "Uso: http_client <URL> [URL...] [método] [opções]\n";
+    std::cout << "Métodos: GET, POST, PUT, DELETE, HEAD (padrão: GET)\n";
+    std::cout << "Opções:\n";
+    std::cout << "  --data <dados>      Dados para POST/PUT\n";
+    std::cout << "  --data-file <arq>   Enviar o arquivo como corpo (sendfile, sem cópia)\n";
+    std::cout << "  --headers <header>  Headers adicionais (ex: \"Authorization: Bearer token\")\n";
+    std::cout << "  --repeat <n>        Repetir a requisição n vezes reutilizando a conexão\n";
+    std::cout << "  --parallel <n>      Requisições simultâneas com várias URLs (padrão: 64)\n";
+    std::cout << "  --pipeline          Várias URLs em pipeline HTTP/1.1 na mesma conexão\n";
+    std::cout << "  --rcvbuf <bytes>    SO_RCVBUF das conexões (padrão: o do kernel)\n";
+    std::cout << "  --sndbuf <bytes>    SO_SNDBUF das conexões\n";
+    std::cout << "  --fastopen          TCP Fast Open (dados no SYN em reconexões)\n";
+    std::cout << "  --nagle             Não desativar o algoritmo de Nagle (TCP_NODELAY)\n";
+    std::cout << "  --no-reuse          Conexão nova a cada requisição (mede a retomada TLS)\n";
+    std::cout << "  --insecure          HTTPS sem verificar o certificado do servidor\n";
+    std::cout << "  --no-early-data     HTTPS sem 0-RTT ao retomar sessões TLS 1.3\n";
+    std::cout << "  --compressed        Pedir resposta comprimida e descomprimir durante a recepção\n";
+    std::cout << "  --raw               Só o corpo, sem formatação, direto no stdout (splice se for pipe)\n";
+    std::cout << "  --save <arquivo>    Gravar o corpo no arquivo (splice quando possível)\n";
+    std::cout << "  --trace <formato>   Tempos por fase: json (uma linha por requisição) ou prometheus\n";
+    std::cout << "  --trace-file <arq>  Destino do trace (padrão: stderr)\n";
+    std::cout << "  --help              Mostrar esta ajuda\n";
+    std::cout << "Benchmark (--bench, motor assíncrono com keep-alive):\n";
+    std::cout << "  --concurrency <n>   Requisições em voo (padrão: 10)\n";
+    std::cout << "  --duration <s>      Duração do teste (padrão: 10s sem --requests)\n";
+    std::cout << "  --requests <n>      Total de requisições\n";
+    std::cout << "  --rate <r>          Requisições/s agendadas (latência desde o horário agendado)\n";
+    std::cout << "  --output <formato>  text, csv ou json\n";
+    std::cout << "Diagnóstico:\n";
+    std::cout << "  http_client --bench-parser [iterações]  Compara parser manual e regex\n";
+}
 
-            buffer[bytes_received] = '\0';
-            raw_response.append(buffer, bytes_received);
-        }
+// --- Saída do corpo ---
 
-        if (raw_response.empty()) {
-            std::cerr << "Nenhuma resposta recebida" << std::endl;
-            return response;
-        }
+// Buffer fixo sobre um descritor: muitas escritas pequenas (o pretty-print
+// emite caractere a caractere) viram poucas chamadas write(); blocos do
+// tamanho do buffer ou maiores passam direto, sem cópia.
+class OutputSink {
+public:
+    static constexpr size_t CAPACITY = 64 * 1024;
 
-        // Parse da resposta
-        parse_http_response(raw_response, response);
+    explicit OutputSink(int fd) : fd(fd), buffer(new char[CAPACITY]) {}
 
-        return response;
+    ~OutputSink() {
+        flush();
     }
 
-    void parse_http_response(const std::string& raw_response, HTTPResponse& response) {
-        std::istringstream stream(raw_response);
-        std::string line;
+    OutputSink(const OutputSink&) = delete;
+    OutputSink& operator=(const OutputSink&) = delete;
 
-        // Linha de status
-        if (std::getline(stream, line)) {
-            parse_status_line(line, response);
+    void put(char c) {
+        if (used == CAPACITY) {
+            flush();
         }
+        buffer[used++] = c;
+    }
 
-        // Headers
-        while (std::getline(stream, line) && line != "\r" && !line.empty()) {
-            parse_header_line(line, response);
+    void write(const char* data, size_t length) {
+        if (length >= CAPACITY) {
+            flush();
+            failed = failed || !write_all(fd, data, length);
+            return;
         }
-
-        // Body
-        size_t header_end = raw_response.find("\r\n\r\n");
-        if (header_end != std::string::npos) {
-            response.body = raw_response.substr(header_end + 4);
+        if (CAPACITY - used < length) {
+            flush();
         }
+        memcpy(buffer.get() + used, data, length);
+        used += length;
+    }
 
-        // Tratar chunked encoding
-        if (response.headers.count("Transfer-Encoding") &&
-            response.headers["Transfer-Encoding"] == "chunked") {
-            response.body = parse_chunked_body(response.body);
+    // count cópias de c (indentação) sem string temporária
+    void fill(char c, size_t count) {
+        while (count > 0) {
+            if (used == CAPACITY) {
+                flush();
+            }
+            size_t n = std::min(count, CAPACITY - used);
+            memset(buffer.get() + used, c, n);
+            used += n;
+            count -= n;
         }
     }
 
-    void parse_status_line(const std::string& line, HTTPResponse& response) {
-        std::istringstream ss(line);
-        ss >> response.version >> response.status_code;
+    bool flush() {
+        if (used > 0) {
+            failed = failed || !write_all(fd, buffer.get(), used);
+            used = 0;
+        }
+        return !failed;
+    }
 
-        // Ler texto do status (resto da linha)
-        std::getline(ss, response.status_text);
+    bool ok() const { return !failed; }
 
-        // Remover espaços em branco do início/fim
-        response.status_text = std::regex_replace(response.status_text,
-                                                std::regex("^\\s+|\\s+$"), "");
-    }
+private:
+    int fd;
+    std::unique_ptr<char[]> buffer;
+    size_t used = 0;
+    bool failed = false;
+};
 
-    void parse_header_line(const std::string& line, HTTPResponse& response) {
-        size_t colon_pos = line.find(':');
-        if (colon_pos != std::string::npos) {
-            std::string key = line.substr(0, colon_pos);
-            std::string value = line.substr(colon_pos + 1);
+// Pretty-print incremental de JSON: consome os segmentos do corpo na ordem em
+// que o parser os entrega e escreve no sink, sem montar cópia do documento.
+// Indentação, string aberta e escape pendente atravessam os limites dos
+// segmentos. Não valida: entrada malformada sai reindentada como der.
+class JSONPrettyPrinter {
+public:
+    static constexpr size_t INDENT = 2;
+
+    explicit JSONPrettyPrinter(OutputSink& sink) : sink(sink) {}
+
+    void feed(const char* data, size_t length) {
+        size_t i = 0;
+        while (i < length) {
+            if (in_string) {
+                if (escaped) {
+                    sink.put(data[i++]);
+                    escaped = false;
+                    continue;
+                }
+                // Conteúdo da string até a próxima aspa ou barra sai de uma vez
+                size_t end = i;
+                while (end < length && data[end] != '"' && data[end] != '\\') {
+                    end++;
+                }
+                sink.write(data + i, end - i);
+                i = end;
+                if (i < length) {
+                    char c = data[i++];
+                    sink.put(c);
+                    if (c == '\\') {
+                        escaped = true;
+                    } else {
+                        in_string = false;
+                    }
+                }
+                continue;
+            }
 
-            // Remover espaços em branco
-            key = std::regex_replace(key, std::regex("^\\s+|\\s+$"), "");
-            value = std::regex_replace(value, std::regex("^\\s+|\\s+$"), "");
+            char c = data[i++];
+            if (c == ' ' || c == '\n' || c == '\r' || c == '\t') {
+                continue; // Espaço entre tokens é refeito pela indentação
+            }
 
-            response.headers[key] = value;
+            bool closing = c == '}' || c == ']';
+            if (open_pending) {
+                open_pending = false;
+                if (closing) {
+                    // Objeto ou array vazio fica numa linha só: {} e []
+                    depth--;
+                    sink.put(c);
+                    continue;
+                }
+                newline();
+            }
 
-            // Extrair Content-Length
-            if (key == "Content-Length") {
-                response.content_length = std::stoul(value);
+            if (c == '{' || c == '[') {
+                sink.put(c);
+                depth++;
+                open_pending = true;
+            } else if (closing) {
+                depth = depth > 0 ? depth - 1 : 0;
+                newline();
+                sink.put(c);
+            } else if (c == ',') {
+                sink.put(c);
+                newline();
+            } else if (c == ':') {
+                sink.write(": ", 2);
+            } else {
+                if (c == '"') {
+                    in_string = true;
+                }
+                sink.put(c);
             }
         }
     }
 
-    std::string parse_chunked_body(const std::string& chunked_body) {
-        std::string result;
-        std::istringstream stream(chunked_body);
-        std::string line;
-
-        while (std::getline(stream, line)) {
-            // Tamanho do chunk em hexadecimal
-            size_t chunk_size;
-            std::stringstream ss;
-            ss << std::hex << line;
-            ss >> chunk_size;
+private:
+    OutputSink& sink;
+    size_t depth = 0;
+    bool in_string = false;
+    bool escaped = false;
+    bool open_pending = false; // '{' ou '[' escrito; a quebra de linha espera o próximo token
+
+    void newline() {
+        sink.put('\n');
+        sink.fill(' ', depth * INDENT);
+    }
+};
 
-            if (chunk_size == 0) {
-                break; // Fim dos chunks
+// Corpo no terminal à medida que chega: JSON (começa com { ou [) passa pelo
+// pretty-print, o resto sai como veio
+class BodyPrinter {
+public:
+    explicit BodyPrinter(OutputSink& sink) : sink(sink), json(sink) {}
+
+    void feed(const char* data, size_t length) {
+        bytes += length;
+        // Até o primeiro caractere do corpo, BOM UTF-8 e espaços ficam retidos
+        size_t start = 0;
+        while (!decided && start < length) {
+            char c = data[start];
+            if (bom < 3 && leading.size() == bom && c == UTF8_BOM[bom]) {
+                bom++;
+            } else if (c != ' ' && c != '\n' && c != '\r' && c != '\t') {
+                decided = true;
+                is_json = c == '{' || c == '[';
+                if (!is_json) {
+                    sink.write(leading.data(), leading.size());
+                }
+                break;
             }
-
-            // Ler dados do chunk
-            std::string chunk_data;
-            chunk_data.resize(chunk_size);
-            stream.read(&chunk_data[0], chunk_size);
-
-            result += chunk_data;
-
-            // Pular \r\n após o chunk
-            stream.ignore(2);
+            leading += c;
+            start++;
+        }
+        if (!decided) {
+            return;
+        }
+        if (is_json) {
+            json.feed(data + start, length - start);
+        } else {
+            sink.write(data + start, length - start);
         }
+    }
 
-        return result;
+    // Corpo só com espaços: sai como veio
+    void finish() {
+        if (!decided) {
+            sink.write(leading.data(), leading.size());
+            decided = true;
+        }
     }
-};
 
-void print_usage() {
-    std::cout << "Uso: http_client <URL> [método] [opções]\n";
-    std::cout << "Métodos: GET, POST, PUT, DELETE, HEAD (padrão: GET)\n";
-    std::cout << "Opções:\n";
-    std::cout << "  --data <dados>      Dados para POST/PUT\n";
-    std::cout << "  --headers <header>  Headers adicionais (ex: \"Authorization: Bearer token\")\n";
-    std::cout << "  --help              Mostrar esta ajuda\n";
-}
+    size_t size() const { return bytes; }
+
+private:
+    static constexpr const char* UTF8_BOM = "\xEF\xBB\xBF";
+
+    OutputSink& sink;
+    JSONPrettyPrinter json;
+    std::string leading;
+    size_t bom = 0;
+    bool decided = false;
+    bool is_json = false;
+    size_t bytes = 0;
+};
 
-void print_response(const HTTPClient::HTTPResponse& response, bool show_headers = true) {
+void print_response_head(const HTTPClient::HTTPResponse& response, bool show_headers = true) {
     std::cout << "=== RESPOSTA HTTP ===\n";
     std::cout << response.version << " " << response.status_code << " " << response.status_text << "\n";
 
@@ -321,56 +3318,273 @@ void print_response(const HTTPClient::HTTPResponse& response, bool show_headers
     }
 
     std::cout << "\n--- BODY ---\n";
-    if (!response.body.empty()) {
-        // Tentar identificar e formatar JSON
-        if (response.body[0] == '{' || response.body[0] == '[') {
-            // Simples pretty print para JSON
-            std::string formatted;
-            int indent = 0;
-            bool in_string = false;
-
-            for (char c : response.body) {
-                if (c == '\"' && (formatted.empty() || formatted.back() != '\\')) {
-                    in_string = !in_string;
-                }
-
-                if (!in_string) {
-                    if (c == '{' || c == '[') {
-                        formatted += c;
-                        formatted += '\n';
-                        indent += 2;
-                        formatted += std::string(indent, ' ');
-                    } else if (c == '}' || c == ']') {
-                        formatted += '\n';
-                        indent -= 2;
-                        formatted += std::string(indent, ' ');
-                        formatted += c;
-                    } else if (c == ',') {
-                        formatted += c;
-                        formatted += '\n';
-                        formatted += std::string(indent, ' ');
-                    } else if (c == ':') {
-                        formatted += ": ";
-                    } else {
-                        formatted += c;
-                    }
-                } else {
-                    formatted += c;
-                }
-            }
-            std::cout << formatted << "\n";
+}
+
+// body_bytes: corpo já decodificado, como foi entregue à saída
+void print_response_stats(const HTTPClient::HTTPResponse& response, size_t body_bytes) {
+    std::cout << "\n=== ESTATÍSTICAS ===\n";
+    std::cout << "Tamanho do conteúdo: " << body_bytes << " bytes\n";
+    if (response.content_length > 0) {
+        std::cout << "Content-Length: " << response.content_length << " bytes\n";
+    }
+    std::cout << "Corpo na rede: " << response.wire_length << " bytes";
+    auto encoding = std::find_if(response.headers.begin(), response.headers.end(),
+                                 [](const auto& header) {
+        return iequals(header.first, "Content-Encoding");
+    });
+    if (encoding != response.headers.end()) {
+        std::cout << " (" << encoding->second << ")";
+    }
+    std::cout << ", decodificado: " << response.decoded_length << " bytes";
+    if (response.wire_length > 0 && response.decoded_length != response.wire_length) {
+        std::cout << " (" << std::fixed << std::setprecision(1)
+                  << static_cast<double>(response.decoded_length) / response.wire_length
+                  << "x)";
+    }
+    std::cout << "\n";
+}
+
+// Rótulos de --trace: host em vez da URL mantém baixa a cardinalidade das séries
+void record_trace(TraceWriter& trace_output, const std::string& method, const std::string& url,
+                  const HTTPClient::HTTPResponse& response) {
+    if (!trace_output.enabled()) {
+        return;
+    }
+    URLView view;
+    std::string host = parse_url_view(url, view) ? std::string(view.host) : url;
+    trace_output.record(response.trace, {{"method", method}, {"host", host},
+                                         {"status", std::to_string(response.status_code)}});
+}
+
+int run_batch(HTTPClient& client, const std::vector<std::string>& urls, const std::string& method,
+              const std::string& data, const std::map<std::string, std::string>& headers,
+              int repeat, TraceWriter& trace_output) {
+    std::vector<HTTPClient::BatchRequest> requests;
+    for (int r = 0; r < repeat; r++) {
+        for (const auto& target : urls) {
+            requests.push_back({method, target, data, headers});
+        }
+    }
+
+    std::cout << "Enviando lote de " << requests.size() << " requisições " << method << std::endl;
+
+    auto start = std::chrono::steady_clock::now();
+    auto results = client.batch(requests);
+    auto duration = std::chrono::duration_cast<std::chrono::milliseconds>(
+        std::chrono::steady_clock::now() - start);
+
+    size_t failed = 0;
+    for (size_t i = 0; i < results.size(); i++) {
+        const auto& result = results[i];
+        record_trace(trace_output, requests[i].method, requests[i].url, result.response);
+        std::cout << requests[i].url << ": ";
+        if (result.response.status_code == 0) {
+            failed++;
+            std::cout << "falha";
         } else {
-            std::cout << response.body << "\n";
+            std::cout << result.response.status_code << " " << result.response.body.length()
+                      << " bytes";
         }
-    } else {
-        std::cout << "(vazio)\n";
+        std::cout << " em " << std::fixed << std::setprecision(3)
+                  << result.latency.count() / 1000.0 << "ms"
+                  << (result.pipelined ? " (pipeline)" : " (sequencial)") << "\n";
     }
 
     std::cout << "\n=== ESTATÍSTICAS ===\n";
-    std::cout << "Tamanho do conteúdo: " << response.body.length() << " bytes\n";
-    if (response.content_length > 0) {
-        std::cout << "Content-Length: " << response.content_length << " bytes\n";
+    std::cout << "Sucesso: " << results.size() - failed << ", falhas: " << failed << "\n";
+    std::cout << "Tempo total: " << duration.count() << "ms\n";
+    return failed == 0 ? 0 : 1;
+}
+
+int run_async(HTTPClient& client, const std::vector<std::string>& urls, const std::string& method,
+              const std::string& data, const std::map<std::string, std::string>& headers,
+              int repeat, size_t parallel, TraceWriter& trace_output) {
+    AsyncHTTPEngine engine(client, parallel);
+    size_t succeeded = 0;
+    size_t failed = 0;
+
+    std::cout << "Enviando " << urls.size() * repeat << " requisições " << method
+              << " (até " << parallel << " em paralelo)" << std::endl;
+
+    auto start = std::chrono::steady_clock::now();
+    for (int r = 0; r < repeat; r++) {
+        for (const auto& target : urls) {
+            auto submitted = std::chrono::steady_clock::now();
+            engine.submit(method, target,
+                          [&, target, submitted](HTTPClient::HTTPResponse& response,
+                                                 const std::string& error) {
+                auto elapsed = std::chrono::duration_cast<std::chrono::microseconds>(
+                    std::chrono::steady_clock::now() - submitted);
+                record_trace(trace_output, method, target, response);
+                if (!error.empty()) {
+                    failed++;
+                    std::cout << target << ": " << error << "\n";
+                    return;
+                }
+                succeeded++;
+                std::cout << target << ": " << response.status_code << " "
+                          << response.status_text << " " << response.body.length()
+                          << " bytes em " << std::fixed << std::setprecision(3)
+                          << elapsed.count() / 1000.0 << "ms\n";
+            }, data, headers);
+        }
+    }
+    engine.run();
+    auto duration = std::chrono::duration_cast<std::chrono::milliseconds>(
+        std::chrono::steady_clock::now() - start);
+
+    std::cout << "\n=== ESTATÍSTICAS ===\n";
+    std::cout << "Sucesso: " << succeeded << ", falhas: " << failed << "\n";
+    std::cout << "Tempo total: " << duration.count() << "ms\n";
+    return failed == 0 ? 0 : 1;
+}
+
+struct BenchmarkOptions {
+    size_t concurrency = 10;
+    std::chrono::milliseconds duration{0}; // 0 e sem requests: 10s
+    uint64_t requests = 0;                 // 0: limitado só pela duração
+    double rate = 0;                       // Requisições/s; 0: cada resposta dispara a próxima
+    std::string output = "text";           // text, csv ou json
+};
+
+// Gerador de carga estilo wrk sobre o AsyncHTTPEngine: concurrency
+// requisições em voo, conexões keep-alive reaproveitadas e cada conclusão
+// submetendo a próxima. Com rate, os inícios são agendados em intervalos
+// fixos e a latência conta a partir do horário agendado (como no wrk2): um
+// servidor lento não reduz a carga nem esconde a fila dos percentis.
+int run_benchmark(HTTPClient& client, const std::vector<std::string>& urls,
+                  const std::string& method, const std::string& data,
+                  const std::map<std::string, std::string>& headers,
+                  const BenchmarkOptions& options) {
+    using Clock = std::chrono::steady_clock;
+
+    // Alvos que o motor recusaria falhariam em toda requisição do teste
+    for (const auto& target : urls) {
+        HTTPClient::URL parsed;
+        if (!parsed.parse(target)) {
+            return 1; // parse() já explicou o erro
+        }
+        if (parsed.protocol == "https") {
+            std::cerr << "Benchmark não suporta HTTPS: " << target << std::endl;
+            return 1;
+        }
+    }
+
+    AsyncHTTPEngine engine(client, options.concurrency);
+    LatencyHistogram<> latency; // Nanossegundos
+    uint64_t issued = 0;
+    uint64_t succeeded = 0;
+    uint64_t http_errors = 0;
+    uint64_t failed = 0;
+    std::map<std::string, uint64_t> errors;
+
+    auto duration = options.duration;
+    if (duration.count() == 0 && options.requests == 0) {
+        duration = std::chrono::seconds(10);
+    }
+    Clock::time_point start = Clock::now();
+    Clock::time_point stop = duration.count() > 0 ? start + duration : Clock::time_point::max();
+    auto interval = std::chrono::nanoseconds(
+        options.rate > 0 ? static_cast<int64_t>(1e9 / options.rate) : 0);
+
+    if (options.output == "text") {
+        std::cout << "Benchmark " << method << " em " << urls.size() << " URL(s), "
+                  << options.concurrency << " em paralelo";
+        if (options.rate > 0) {
+            std::cout << ", " << options.rate << " req/s";
+        }
+        if (duration.count() > 0) {
+            std::cout << ", " << duration.count() / 1000.0 << "s";
+        }
+        if (options.requests > 0) {
+            std::cout << ", até " << options.requests << " requisições";
+        }
+        std::cout << std::endl;
     }
+
+    std::function<void()> issue = [&]() {
+        if (options.requests > 0 && issued >= options.requests) {
+            return;
+        }
+        Clock::time_point scheduled =
+            options.rate > 0 ? start + interval * static_cast<int64_t>(issued) : Clock::now();
+        if (scheduled >= stop) {
+            return;
+        }
+        const std::string& target = urls[issued % urls.size()];
+        issued++;
+        engine.submit_at(scheduled, method, target,
+                         [&, scheduled](HTTPClient::HTTPResponse& response,
+                                        const std::string& error) {
+            if (!error.empty()) {
+                failed++;
+                errors[error]++;
+            } else {
+                latency.record(std::chrono::duration_cast<std::chrono::nanoseconds>(
+                                   Clock::now() - scheduled).count());
+                succeeded++;
+                if (response.status_code >= 400) {
+                    http_errors++;
+                }
+            }
+            issue();
+        }, data, headers);
+    };
+
+    for (size_t i = 0; i < options.concurrency; i++) {
+        issue();
+    }
+    engine.run();
+
+    double elapsed = std::chrono::duration<double>(Clock::now() - start).count();
+    double rps = elapsed > 0 ? succeeded / elapsed : 0;
+    double received_rate = elapsed > 0 ? engine.bytes_received() / elapsed : 0;
+    auto us = [&](double percent) { return latency.percentile(percent) / 1000.0; };
+
+    if (options.output == "csv") {
+        std::cout << "requests,errors,http_errors,duration_s,requests_per_s,bytes_received,"
+                     "bytes_sent,received_bytes_per_s,latency_min_us,latency_mean_us,"
+                     "latency_p50_us,latency_p90_us,latency_p99_us,latency_p999_us,"
+                     "latency_max_us\n";
+        std::cout << std::fixed << std::setprecision(3) << succeeded << "," << failed << ","
+                  << http_errors << "," << elapsed << "," << rps << ","
+                  << engine.bytes_received() << "," << engine.bytes_sent() << ","
+                  << received_rate << "," << latency.min() / 1000.0 << ","
+                  << latency.mean() / 1000.0 << "," << us(50) << "," << us(90) << ","
+                  << us(99) << "," << us(99.9) << "," << latency.max() / 1000.0 << "\n";
+    } else if (options.output == "json") {
+        std::cout << std::fixed << std::setprecision(3) << "{\"requests\": " << succeeded
+                  << ", \"errors\": " << failed << ", \"http_errors\": " << http_errors
+                  << ", \"duration_s\": " << elapsed << ", \"requests_per_s\": " << rps
+                  << ", \"bytes_received\": " << engine.bytes_received()
+                  << ", \"bytes_sent\": " << engine.bytes_sent()
+                  << ", \"received_bytes_per_s\": " << received_rate
+                  << ", \"latency_us\": {\"min\": " << latency.min() / 1000.0
+                  << ", \"mean\": " << latency.mean() / 1000.0 << ", \"p50\": " << us(50)
+                  << ", \"p90\": " << us(90) << ", \"p99\": " << us(99)
+                  << ", \"p999\": " << us(99.9) << ", \"max\": " << latency.max() / 1000.0
+                  << "}}\n";
+    } else {
+        std::cout << std::fixed << std::setprecision(3);
+        std::cout << "\n=== ESTATÍSTICAS ===\n";
+        std::cout << "Requisições: " << succeeded << " em " << elapsed << "s ("
+                  << std::setprecision(1) << rps << " req/s)\n";
+        std::cout << "Recebido: " << engine.bytes_received() << " bytes ("
+                  << received_rate / (1024 * 1024) << " MB/s), enviado: "
+                  << engine.bytes_sent() << " bytes\n";
+        std::cout << std::setprecision(3);
+        std::cout << "Latência min/avg/max: " << latency.min() / 1e6 << "/"
+                  << latency.mean() / 1e6 << "/" << latency.max() / 1e6 << " ms\n";
+        std::cout << "Percentis: p50 " << us(50) / 1000 << " ms, p90 " << us(90) / 1000
+                  << " ms, p99 " << us(99) / 1000 << " ms, p99.9 " << us(99.9) / 1000 << " ms\n";
+        std::cout << "Erros: " << failed << " de conexão/timeout, " << http_errors
+                  << " respostas 4xx/5xx\n";
+        for (const auto& entry : errors) {
+            std::cout << "  " << entry.second << "x " << entry.first << "\n";
+        }
+    }
+
+    return failed == 0 && http_errors == 0 ? 0 : 1;
 }
 
 int main(int argc, char* argv[]) {
@@ -379,10 +3593,31 @@ int main(int argc, char* argv[]) {
         return 1;
     }
 
+    if (std::string(argv[1]) == "--bench-parser") {
+        run_parser_benchmark(argc > 2 ? std::max(1, std::atoi(argv[2])) : 100000);
+        return 0;
+    }
+
     std::string url = argv[1];
     std::string method = "GET";
     std::string data;
+    std::string data_file;
     std::map<std::string, std::string> headers;
+    int repeat = 1;
+    size_t parallel = 64;
+    bool pipeline = false;
+    std::vector<std::string> urls{url};
+    SocketTuning tuning;
+    bool reuse = true;
+    bool verify = true;
+    bool early_data = true;
+    bool compressed = false;
+    bool bench = false;
+    BenchmarkOptions bench_options;
+    std::string trace_format;
+    std::string trace_file;
+    bool raw = false;
+    std::string save_file;
 
     // Parse argumentos
     for (int i = 2; i < argc; i++) {
@@ -394,6 +3629,9 @@ int main(int argc, char* argv[]) {
         } else if (arg == "--data" && i + 1 < argc) {
             data = argv[++i];
             if (method == "GET") method = "POST"; // Default para POST se tiver dados
+        } else if (arg == "--data-file" && i + 1 < argc) {
+            data_file = argv[++i];
+            if (method == "GET") method = "POST";
         } else if (arg == "--headers" && i + 1 < argc) {
             std::string header_line = argv[++i];
             size_t colon_pos = header_line.find(':');
@@ -402,6 +3640,56 @@ int main(int argc, char* argv[]) {
                 std::string value = header_line.substr(colon_pos + 1);
                 headers[key] = value;
             }
+        } else if (arg == "--repeat" && i + 1 < argc) {
+            repeat = std::max(1, std::atoi(argv[++i]));
+        } else if (arg == "--pipeline") {
+            pipeline = true;
+        } else if (arg == "--parallel" && i + 1 < argc) {
+            parallel = std::max(1, std::atoi(argv[++i]));
+        } else if (arg == "--rcvbuf" && i + 1 < argc) {
+            tuning.receive_buffer = std::max(0, std::atoi(argv[++i]));
+        } else if (arg == "--sndbuf" && i + 1 < argc) {
+            tuning.send_buffer = std::max(0, std::atoi(argv[++i]));
+        } else if (arg == "--fastopen") {
+            tuning.fast_open = true;
+        } else if (arg == "--nagle") {
+            tuning.no_delay = false;
+        } else if (arg == "--no-reuse") {
+            reuse = false;
+        } else if (arg == "--insecure") {
+            verify = false;
+        } else if (arg == "--no-early-data") {
+            early_data = false;
+        } else if (arg == "--compressed") {
+            compressed = true;
+        } else if (arg == "--raw") {
+            raw = true;
+        } else if (arg == "--save" && i + 1 < argc) {
+            save_file = argv[++i];
+        } else if (arg == "--trace" && i + 1 < argc) {
+            trace_format = argv[++i];
+        } else if (arg == "--trace-file" && i + 1 < argc) {
+            trace_file = argv[++i];
+        } else if (arg == "--bench") {
+            bench = true;
+        } else if (arg == "--concurrency" && i + 1 < argc) {
+            bench_options.concurrency = std::max(1, std::atoi(argv[++i]));
+        } else if (arg == "--duration" && i + 1 < argc) {
+            bench_options.duration = std::chrono::milliseconds(
+                static_cast<int64_t>(std::max(0.0, std::atof(argv[++i])) * 1000));
+        } else if (arg == "--requests" && i + 1 < argc) {
+            bench_options.requests = std::max(0LL, std::atoll(argv[++i]));
+        } else if (arg == "--rate" && i + 1 < argc) {
+            bench_options.rate = std::max(0.0, std::atof(argv[++i]));
+        } else if (arg == "--output" && i + 1 < argc) {
+            bench_options.output = argv[++i];
+            if (bench_options.output != "text" && bench_options.output != "csv" &&
+                bench_options.output != "json") {
+                std::cerr << "Formato desconhecido: " << bench_options.output << std::endl;
+                return 1;
+            }
+        } else if (arg.compare(0, 7, "http://") == 0 || arg.compare(0, 8, "https://") == 0) {
+            urls.push_back(arg);
         } else if (arg == "GET" || arg == "POST" || arg == "PUT" ||
                   arg == "DELETE" || arg == "HEAD") {
             method = arg;
@@ -419,26 +3707,148 @@ int main(int argc, char* argv[]) {
         }
     }
 
+    // Escritas em conexão fechada pelo servidor (ex: sendfile) retornam EPIPE
+    signal(SIGPIPE, SIG_IGN);
+
     HTTPClient client;
+    client.set_socket_tuning(tuning);
+    client.set_tls_options(verify, early_data);
+    if (!client.set_accept_encoding(compressed)) {
+        std::cerr << "Sem suporte a compressão: compile com -DHTTP_WITH_ZLIB -lz e/ou "
+                     "-DHTTP_WITH_BROTLI -lbrotlidec" << std::endl;
+    }
+    if (!reuse) {
+        client.set_pool_limits(0, std::chrono::seconds(0));
+    }
+    TraceWriter trace_output;
+    if (!trace_format.empty()) {
+        std::string error;
+        if (!trace_output.open(trace_format, trace_file, "http_client", error)) {
+            std::cerr << error << std::endl;
+            return 1;
+        }
+    }
+    // Corpo sem passar por response.body: stdout (--raw) ou arquivo (--save)
+    int body_fd = -1;
+    if (raw || !save_file.empty()) {
+        if (bench || urls.size() > 1) {
+            std::cerr << "--raw e --save aceitam uma única URL" << std::endl;
+            return 1;
+        }
+        body_fd = STDOUT_FILENO;
+        if (!save_file.empty()) {
+            body_fd = open(save_file.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+            if (body_fd < 0) {
+                std::cerr << "Erro ao criar " << save_file << ": " << strerror(errno) << std::endl;
+                return 1;
+            }
+        }
+        client.set_body_output(body_fd);
+    }
+    auto send_once = [&](const HTTPClient::BodyCallback& on_body,
+                         const HTTPClient::HeadersCallback& on_headers) {
+        auto response = data_file.empty()
+            ? client.request(method, url, data, headers, on_body, on_headers)
+            : client.request_file(method, url, data_file, headers, on_body, on_headers);
+        record_trace(trace_output, method, url, response);
+        return response;
+    };
+
+    if (bench) {
+        return run_benchmark(client, urls, method, data, headers, bench_options);
+    }
+
+    // Várias URLs: em pipeline numa conexão, ou em paralelo no motor assíncrono
+    if (urls.size() > 1 && pipeline) {
+        int status = run_batch(client, urls, method, data, headers, repeat, trace_output);
+        trace_output.finish();
+        return status;
+    }
+    if (urls.size() > 1) {
+        int status = run_async(client, urls, method, data, headers, repeat, parallel, trace_output);
+        trace_output.finish();
+        return status;
+    }
 
-    std::cout << "Enviando requisição " << method << " para " << url << std::endl;
+    // --raw: o stdout é só do corpo
+    std::ostream& log = raw ? std::cerr : std::cout;
+    log << "Enviando requisição " << method << " para " << url << std::endl;
     if (!data.empty()) {
-        std::cout << "Com dados: " << data << std::endl;
+        log << "Com dados: " << data << std::endl;
     }
+    if (!data_file.empty()) {
+        log << "Com arquivo: " << data_file << std::endl;
+    }
+
+    // Status e headers saem antes do corpo, que é formatado à medida que chega
+    OutputSink sink(STDOUT_FILENO);
+    BodyPrinter printer(sink);
+    HTTPClient::HeadersCallback show_head = [&](const HTTPClient::HTTPResponse& head) {
+        print_response_head(head);
+        std::cout.flush(); // O corpo vai direto ao descritor
+    };
+    auto show_body = [&](const char* data, size_t length) {
+        printer.feed(data, length);
+    };
 
     auto start = std::chrono::steady_clock::now();
-    auto response = client.request(method, url, data, headers);
+    auto response = body_fd >= 0 ? send_once(nullptr, raw ? nullptr : show_head)
+                                 : send_once(show_body, show_head);
     auto end = std::chrono::steady_clock::now();
+    printer.finish();
+    sink.flush();
 
     if (response.status_code == 0) {
+        if (printer.size() > 0) {
+            std::cout << std::endl;
+        }
         std::cerr << "Erro na requisição HTTP" << std::endl;
+        trace_output.finish();
         return 1;
     }
 
-    print_response(response);
+    if (!raw) {
+        if (body_fd >= 0) {
+            std::cout << "(gravado em " << save_file << ")\n";
+        } else {
+            std::cout << (printer.size() > 0 ? "\n" : "(vazio)\n");
+        }
+        print_response_stats(response, body_fd >= 0 ? response.decoded_length : printer.size());
+    }
 
     auto duration = std::chrono::duration_cast<std::chrono::milliseconds>(end - start);
-    std::cout << "Tempo total: " << duration.count() << "ms\n";
+    log << "Tempo total: " << duration.count() << "ms\n";
+
+    // Requisições seguintes reutilizam a conexão do pool (sem DNS nem handshake TCP).
+    // Só o primeiro corpo vai para --raw/--save; os demais ficam na resposta.
+    client.set_body_output(-1);
+    for (int r = 2; r <= repeat; r++) {
+        start = std::chrono::steady_clock::now();
+        auto next = send_once(nullptr, nullptr);
+        end = std::chrono::steady_clock::now();
+
+        auto elapsed = std::chrono::duration_cast<std::chrono::microseconds>(end - start);
+        log << "Requisição " << r << ": " << next.status_code << " "
+            << next.decoded_length << " bytes em "
+            << std::fixed << std::setprecision(3) << elapsed.count() / 1000.0 << "ms\n";
+    }
+    trace_output.finish();
+    if (!save_file.empty()) {
+        close(body_fd);
+    }
+
+#ifdef HTTP_WITH_TLS
+    const TLSContext::Stats& tls_stats = client.tls_stats();
+    if (tls_stats.full_handshakes + tls_stats.resumed > 0) {
+        log << "Handshakes TLS: " << tls_stats.full_handshakes << " completos, "
+            << tls_stats.resumed << " retomados";
+        if (tls_stats.early_accepted + tls_stats.early_rejected > 0) {
+            log << " (0-RTT: " << tls_stats.early_accepted << " aceitos, "
+                << tls_stats.early_rejected << " recusados)";
+        }
+        log << "\n";
+    }
+#endif
 
     return 0;
 }
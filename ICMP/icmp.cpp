@@ -2,8 +2,16 @@
  * icmp_ping.cpp - Implementação completa de ICMP Echo Request/Reply
  *
  *
- * Compilar: g++ -std=c++17 -Wall icmp_ping.cpp -o icmp_ping
+ * Compilar: g++ -std=c++17 -Wall -pthread icmp_ping.cpp -o icmp_ping
  * Executar: sudo ./icmp 8.8.8.8
+ *           ./icmp 2001:4860:4860::8888                (sem root: cai para socket datagrama)
+ *           ./icmp --dgram 8.8.8.8                      (força SOCK_DGRAM; ver ping_group_range)
+ *           sudo ./icmp -c 10 -i 1000 8.8.8.8 1.1.1.1   (modo contínuo, vários destinos)
+ *           sudo ./icmp -v -T sw 8.8.8.8                (uma linha por resposta, timestamps do kernel)
+ *           sudo ./icmp -q -f hosts.txt                 (destinos de um arquivo)
+ *           sudo ./icmp --traceroute 8.8.8.8             (todos os saltos em paralelo)
+ *           sudo ./icmp --pmtu 8.8.8.8                   (MTU do caminho com DF)
+ *           ./icmp --bench-checksum [iterações]        (micro-benchmark de checksum)
  */
 
  #include <arpa/inet.h>
@@ -12,10 +20,29 @@
  #include <chrono>
  #include <iomanip>
  #include <iostream>
+ #include <fstream>
  #include <vector>
+ #include <deque>
+ #include <unordered_map>
+ #include <csignal>
+ #include <poll.h>
+ #include <thread>
+ #include <mutex>
+ #include <atomic>
+ #include <algorithm>
+ #include <ctime>
+ #include <linux/errqueue.h>
+ #include <linux/filter.h>
+ #include <linux/net_tstamp.h>
+ #if defined(__SSE2__)
+ #include <emmintrin.h>
+ #endif
+ #include "../common/latency_histogram.h"
+ #include "../common/socket_io.h"
  #include <sys/socket.h>
  #include <sys/time.h>
  #include <netinet/ip_icmp.h>
+ #include <netinet/icmp6.h>
  #include <unistd.h>
 
  // --- Constantes e Configurações ---
@@ -35,7 +62,9 @@
  };
 
  // --- Função de Checksum ICMP ---
- uint16_t icmp_checksum(const void* data, size_t length) {
+
+ // Versão escalar de referência (uma palavra de 16 bits por iteração)
+ uint16_t icmp_checksum_scalar(const void* data, size_t length) {
      const uint16_t* words = static_cast<const uint16_t*>(data);
      uint32_t sum = 0;
 
@@ -58,11 +87,85 @@
      return htons(static_cast<uint16_t>(~sum));
  }
 
+ // Soma de complemento de um na ordem nativa dos bytes. A soma da RFC 1071
+ // independe da ordem: somar as palavras como estão na memória e dobrar dá o
+ // mesmo resultado em bytes que somar em big-endian (RFC 1071, 2.(B)).
+ // Com SSE2, 16 bytes por iteração em 4 acumuladores de 64 bits.
+ static uint64_t ones_complement_sum(const uint8_t* bytes, size_t length) {
+     uint64_t sum = 0;
+     size_t i = 0;
+
+ #if defined(__SSE2__)
+     __m128i zero = _mm_setzero_si128();
+     __m128i accumulator = _mm_setzero_si128();
+     for (; i + 16 <= length; i += 16) {
+         __m128i block = _mm_loadu_si128(reinterpret_cast<const __m128i*>(bytes + i));
+         // Palavras de 16 bits -> 32 bits -> somadas em lanes de 64 bits (sem overflow)
+         __m128i low = _mm_unpacklo_epi16(block, zero);
+         __m128i high = _mm_unpackhi_epi16(block, zero);
+         __m128i words = _mm_add_epi32(low, high);
+         accumulator = _mm_add_epi64(accumulator, _mm_unpacklo_epi32(words, zero));
+         accumulator = _mm_add_epi64(accumulator, _mm_unpackhi_epi32(words, zero));
+     }
+     uint64_t lanes[2];
+     _mm_storeu_si128(reinterpret_cast<__m128i*>(lanes), accumulator);
+     sum = lanes[0] + lanes[1];
+ #endif
+
+     // Restante: 8 bytes por vez com dobra de carry de 32 bits
+     for (; i + 8 <= length; i += 8) {
+         uint64_t chunk;
+         memcpy(&chunk, bytes + i, sizeof(chunk));
+         sum += (chunk & 0xFFFFFFFF) + (chunk >> 32);
+     }
+     for (; i + 2 <= length; i += 2) {
+         uint16_t word;
+         memcpy(&word, bytes + i, sizeof(word));
+         sum += word;
+     }
+     if (i < length) {
+         // Byte ímpar completado com zero, na ordem da memória
+         uint8_t tail[2] = {bytes[i], 0};
+         uint16_t word;
+         memcpy(&word, tail, sizeof(word));
+         sum += word;
+     }
+     return sum;
+ }
+
+ static uint16_t fold_checksum(uint64_t sum) {
+     while (sum >> 16) {
+         sum = (sum & 0xFFFF) + (sum >> 16);
+     }
+     return static_cast<uint16_t>(sum);
+ }
+
+ // Checksum ICMP (já em network byte order, pronto para o header)
+ uint16_t icmp_checksum(const void* data, size_t length) {
+     // Pacotes curtos: o laço escalar ganha do setup vetorial
+     if (length < 32) {
+         return icmp_checksum_scalar(data, length);
+     }
+     return static_cast<uint16_t>(~fold_checksum(
+         ones_complement_sum(static_cast<const uint8_t*>(data), length)));
+ }
+
+ // Atualização incremental (RFC 1624, eq. 3): HC' = ~(~HC + ~m + m').
+ // Os valores estão na ordem da memória, como no próprio checksum.
+ uint16_t checksum_adjust(uint16_t checksum, uint16_t old_word, uint16_t new_word) {
+     uint32_t sum = static_cast<uint16_t>(~checksum);
+     sum += static_cast<uint16_t>(~old_word);
+     sum += new_word;
+     return static_cast<uint16_t>(~fold_checksum(sum));
+ }
+
  // --- Cria e configura pacote ICMP Echo Request ---
+ // Echo Request/Reply têm o mesmo layout em ICMPv4 e ICMPv6; só o tipo muda
  std::vector<uint8_t> create_icmp_echo_request(uint16_t identifier, uint16_t sequence,
-                                             const std::string& payload) {
+                                             const std::string& payload,
+                                             uint8_t type = ICMP_ECHO) {
      struct icmphdr header{};
-     header.type = ICMP_ECHO;
+     header.type = type;
      header.code = 0;
      header.un.echo.id = htons(identifier);
      header.un.echo.sequence = htons(sequence);
@@ -86,6 +189,114 @@
      return packet;
  }
 
+ // --- Timestamp no payload ---
+
+ // Os primeiros 8 bytes do payload levam o instante de envio em ns, na ordem
+ // nativa (o eco devolve os mesmos bytes). O RTT sai da resposta em si, sem
+ // depender de estado guardado nem da ordem de chegada.
+ constexpr size_t TIMESTAMP_SIZE = sizeof(uint64_t);
+
+ uint64_t clock_now_ns(clockid_t clock) {
+     timespec now;
+     clock_gettime(clock, &now);
+     return static_cast<uint64_t>(now.tv_sec) * 1000000000ULL + now.tv_nsec;
+ }
+
+ bool read_payload_timestamp(const struct icmphdr* icmp, size_t icmp_length, uint64_t& timestamp) {
+     if (icmp_length < sizeof(icmphdr) + TIMESTAMP_SIZE) {
+         return false;
+     }
+     memcpy(&timestamp, reinterpret_cast<const uint8_t*>(icmp) + sizeof(icmphdr), TIMESTAMP_SIZE);
+     return true;
+ }
+
+ // Origem do instante de recepção. Não há modo por hardware: o timestamp da
+ // NIC vem no relógio do PHC, não no CLOCK_REALTIME do payload, e exigiria
+ // configurar a interface com SIOCSHWTSTAMP.
+ enum class TimestampMode {
+     USERSPACE,  // clock_gettime após o recv
+     SOFTWARE    // SO_TIMESTAMPING: momento em que o kernel recebeu o pacote
+ };
+
+ // Os timestamps do kernel são CLOCK_REALTIME; o envio precisa usar o mesmo relógio
+ clockid_t timestamp_clock(TimestampMode mode) {
+     return mode == TimestampMode::USERSPACE ? CLOCK_MONOTONIC : CLOCK_REALTIME;
+ }
+
+ bool enable_kernel_timestamps(int sock, TimestampMode mode) {
+     if (mode == TimestampMode::USERSPACE) {
+         return true;
+     }
+     int flags = SOF_TIMESTAMPING_RX_SOFTWARE | SOF_TIMESTAMPING_SOFTWARE;
+     return setsockopt(sock, SOL_SOCKET, SO_TIMESTAMPING, &flags, sizeof(flags)) == 0;
+ }
+
+ // Instante de recepção anexado pelo kernel (0 se ausente)
+ uint64_t kernel_receive_time(const msghdr& message) {
+     for (const cmsghdr* cmsg = CMSG_FIRSTHDR(&message); cmsg;
+          cmsg = CMSG_NXTHDR(const_cast<msghdr*>(&message), const_cast<cmsghdr*>(cmsg))) {
+         if (cmsg->cmsg_level != SOL_SOCKET || cmsg->cmsg_type != SCM_TIMESTAMPING) {
+             continue;
+         }
+         scm_timestamping stamps;
+         memcpy(&stamps, CMSG_DATA(cmsg), sizeof(stamps));
+         // ts[0] = software
+         return static_cast<uint64_t>(stamps.ts[0].tv_sec) * 1000000000ULL + stamps.ts[0].tv_nsec;
+     }
+     return 0;
+ }
+
+ // Modelo de Echo Request: o pacote (com payload) é montado uma vez com
+ // id = seq = 0. Cada probe só copia/atualiza id e sequência, e o checksum é
+ // corrigido incrementalmente em vez de recalculado sobre o pacote inteiro.
+ class EchoTemplate {
+ public:
+     explicit EchoTemplate(const std::string& payload, uint8_t type = ICMP_ECHO)
+         : packet(create_icmp_echo_request(0, 0, payload, type)) {
+         memcpy(&base_checksum, packet.data() + 2, sizeof(base_checksum));
+     }
+
+     size_t size() const {
+         return packet.size();
+     }
+
+     // Pacote completo no destino (para inicializar um slot)
+     void copy_to(uint8_t* out) const {
+         memcpy(out, packet.data(), packet.size());
+     }
+
+     // Atualiza só o header de um slot já inicializado com copy_to
+     void stamp(uint8_t* out, uint16_t identifier, uint16_t sequence) const {
+         uint16_t id = htons(identifier);
+         uint16_t seq = htons(sequence);
+         uint16_t checksum = checksum_adjust(checksum_adjust(base_checksum, 0, id), 0, seq);
+         memcpy(out + 2, &checksum, sizeof(checksum));
+         memcpy(out + 4, &id, sizeof(id));
+         memcpy(out + 6, &seq, sizeof(seq));
+     }
+
+     // Idem, gravando também o timestamp no início do payload (que no modelo é zero)
+     void stamp(uint8_t* out, uint16_t identifier, uint16_t sequence, uint64_t timestamp) const {
+         uint16_t id = htons(identifier);
+         uint16_t seq = htons(sequence);
+         uint16_t words[TIMESTAMP_SIZE / 2];
+         memcpy(words, &timestamp, sizeof(words));
+
+         uint16_t checksum = checksum_adjust(checksum_adjust(base_checksum, 0, id), 0, seq);
+         for (uint16_t word : words) {
+             checksum = checksum_adjust(checksum, 0, word);
+         }
+         memcpy(out + 2, &checksum, sizeof(checksum));
+         memcpy(out + 4, &id, sizeof(id));
+         memcpy(out + 6, &seq, sizeof(seq));
+         memcpy(out + sizeof(icmphdr), &timestamp, TIMESTAMP_SIZE);
+     }
+
+ private:
+     std::vector<uint8_t> packet;
+     uint16_t base_checksum;
+ };
+
  // --- Extrai header IP e calcula tamanho ---
  size_t get_ip_header_length(const uint8_t* ip_packet) {
      // Byte 0: Versão (4 bits) + IHL (4 bits)
@@ -95,8 +306,8 @@
 
  // --- Valida resposta ICMP ---
  bool validate_icmp_response(const struct icmphdr* icmp_hdr, uint16_t expected_id,
-                           uint16_t expected_seq) {
-     if (icmp_hdr->type != ICMP_ECHOREPLY || icmp_hdr->code != 0) {
+                           uint16_t expected_seq, uint8_t reply_type = ICMP_ECHOREPLY) {
+     if (icmp_hdr->type != reply_type || icmp_hdr->code != 0) {
          return false;
      }
 
@@ -105,123 +316,1278 @@
             (ntohs(icmp_hdr->un.echo.sequence) == expected_seq);
  }
 
+ // --- Filtro BPF no socket RAW ---
+
+ // Programa BPF clássico para o socket RAW IPv4: aceita só Echo Reply com
+ // (id - base) mod 2^16 < span. O resto do ICMP do host é descartado no kernel,
+ // sem acordar o recv nem ocupar o buffer do socket.
+ bool attach_echo_filter(int sock, uint16_t base_identifier, uint16_t span) {
+     sock_filter code[] = {
+         BPF_STMT(BPF_LDX | BPF_B | BPF_MSH, 0),             // X = tamanho do header IP
+         BPF_STMT(BPF_LD | BPF_B | BPF_IND, 0),              // A = tipo ICMP
+         BPF_JUMP(BPF_JMP | BPF_JEQ | BPF_K, ICMP_ECHOREPLY, 0, 5),
+         BPF_STMT(BPF_LD | BPF_H | BPF_IND, 4),              // A = identificador
+         BPF_STMT(BPF_ALU | BPF_SUB | BPF_K, base_identifier),
+         BPF_STMT(BPF_ALU | BPF_AND | BPF_K, 0xFFFF),
+         BPF_JUMP(BPF_JMP | BPF_JGE | BPF_K, span, 1, 0),
+         BPF_STMT(BPF_RET | BPF_K, 0xFFFFFFFF),              // aceita o pacote inteiro
+         BPF_STMT(BPF_RET | BPF_K, 0),                       // descarta
+     };
+     sock_fprog program{static_cast<unsigned short>(sizeof(code) / sizeof(code[0])), code};
+     if (setsockopt(sock, SOL_SOCKET, SO_ATTACH_FILTER, &program, sizeof(program)) < 0) {
+         return false;
+     }
+
+     // Pacotes enfileirados antes do filtro não passaram por ele
+     uint8_t discard[BUFFER_SIZE];
+     while (recv(sock, discard, sizeof(discard), MSG_DONTWAIT) > 0) {
+     }
+     return true;
+ }
+
+ // --- Socket ICMP: RAW ou datagrama, IPv4 ou IPv6 ---
+
+ enum class SocketMode {
+     AUTO,      // RAW se houver privilégio, senão datagrama
+     RAW,       // SOCK_RAW: exige root/CAP_NET_RAW e recebe todo ICMP do host
+     DATAGRAM   // SOCK_DGRAM ("ping socket"): sem privilégio, o kernel entrega só o nosso ID
+ };
+
+ struct IcmpSocket {
+     Socket handle;
+     int family = AF_INET;
+     bool datagram = false;
+     // No modo datagrama o kernel reescreve o ID com a "porta" do socket
+     uint16_t identifier = 0;
+
+     int fd() const {
+         return handle.fd();
+     }
+
+     uint8_t request_type() const {
+         return family == AF_INET6 ? ICMP6_ECHO_REQUEST : ICMP_ECHO;
+     }
+
+     uint8_t reply_type() const {
+         return family == AF_INET6 ? ICMP6_ECHO_REPLY : ICMP_ECHOREPLY;
+     }
+
+     // Só o RAW IPv4 entrega o header IP junto com a mensagem
+     bool has_ip_header() const {
+         return family == AF_INET && !datagram;
+     }
+ };
+
+ // Endereço literal IPv4 ou IPv6
+ bool parse_address(const char* text, sockaddr_storage& address, socklen_t& length) {
+     address = sockaddr_storage{};
+     auto* v4 = reinterpret_cast<sockaddr_in*>(&address);
+     if (inet_pton(AF_INET, text, &v4->sin_addr) == 1) {
+         v4->sin_family = AF_INET;
+         length = sizeof(sockaddr_in);
+         return true;
+     }
+     auto* v6 = reinterpret_cast<sockaddr_in6*>(&address);
+     if (inet_pton(AF_INET6, text, &v6->sin6_addr) == 1) {
+         v6->sin6_family = AF_INET6;
+         length = sizeof(sockaddr_in6);
+         return true;
+     }
+     return false;
+ }
+
+ bool same_address(const sockaddr_storage& a, const sockaddr_storage& b) {
+     if (a.ss_family != b.ss_family) {
+         return false;
+     }
+     if (a.ss_family == AF_INET) {
+         return reinterpret_cast<const sockaddr_in&>(a).sin_addr.s_addr ==
+                reinterpret_cast<const sockaddr_in&>(b).sin_addr.s_addr;
+     }
+     return memcmp(&reinterpret_cast<const sockaddr_in6&>(a).sin6_addr,
+                   &reinterpret_cast<const sockaddr_in6&>(b).sin6_addr, sizeof(in6_addr)) == 0;
+ }
+
+ std::string address_to_string(const sockaddr_storage& address) {
+     char text[INET6_ADDRSTRLEN];
+     const void* raw = address.ss_family == AF_INET6
+         ? static_cast<const void*>(&reinterpret_cast<const sockaddr_in6&>(address).sin6_addr)
+         : static_cast<const void*>(&reinterpret_cast<const sockaddr_in&>(address).sin_addr);
+     inet_ntop(address.ss_family, raw, text, sizeof(text));
+     return text;
+ }
+
+ // Abre o socket para a família do destino. `identifier` é usado no modo RAW;
+ // no datagrama, vale o ID atribuído pelo kernel no bind.
+ bool open_icmp_socket(int family, SocketMode mode, uint16_t identifier, IcmpSocket& out) {
+     int protocol = family == AF_INET6 ? int(IPPROTO_ICMPV6) : int(IPPROTO_ICMP);
+     out = IcmpSocket{};
+     out.family = family;
+     out.identifier = identifier;
+
+     if (mode != SocketMode::DATAGRAM) {
+         out.handle.reset(socket(family, SOCK_RAW, protocol));
+         if (!out.handle && (mode == SocketMode::RAW || (errno != EPERM && errno != EACCES))) {
+             std::cerr << "Erro ao criar socket RAW: " << strerror(errno) << std::endl;
+             std::cerr << "Execute com privilégios de root (sudo)" << std::endl;
+             return false;
+         }
+     }
+
+     if (!out.handle) {
+         out.handle.reset(socket(family, SOCK_DGRAM, protocol));
+         if (!out.handle) {
+             std::cerr << "Erro ao criar socket ICMP datagrama: " << strerror(errno) << std::endl;
+             std::cerr << "Verifique net.ipv4.ping_group_range ou execute com sudo" << std::endl;
+             return false;
+         }
+         out.datagram = true;
+
+         // Porta 0: o kernel escolhe um ID livre e só nos entrega respostas com ele
+         sockaddr_storage local{};
+         local.ss_family = family;
+         socklen_t local_len = family == AF_INET6 ? sizeof(sockaddr_in6) : sizeof(sockaddr_in);
+         if (bind(out.fd(), reinterpret_cast<sockaddr*>(&local), local_len) < 0 ||
+             getsockname(out.fd(), reinterpret_cast<sockaddr*>(&local), &local_len) < 0) {
+             std::cerr << "Erro no bind do socket ICMP: " << strerror(errno) << std::endl;
+             out.handle.reset();
+             return false;
+         }
+         out.identifier = ntohs(family == AF_INET6
+                                ? reinterpret_cast<sockaddr_in6&>(local).sin6_port
+                                : reinterpret_cast<sockaddr_in&>(local).sin_port);
+     }
+
+     // Sem header IP na recepção, TTL/hop limit vêm por cmsg
+     int on = 1;
+     if (family == AF_INET6) {
+         setsockopt(out.fd(), IPPROTO_IPV6, IPV6_RECVHOPLIMIT, &on, sizeof(on));
+         if (!out.datagram) {
+             // RAW ICMPv6: o kernel descarta tudo que não for Echo Reply
+             icmp6_filter filter;
+             ICMP6_FILTER_SETBLOCKALL(&filter);
+             ICMP6_FILTER_SETPASS(ICMP6_ECHO_REPLY, &filter);
+             setsockopt(out.fd(), IPPROTO_ICMPV6, ICMP6_FILTER, &filter, sizeof(filter));
+         }
+     } else if (out.datagram) {
+         setsockopt(out.fd(), IPPROTO_IP, IP_RECVTTL, &on, sizeof(on));
+     } else if (!attach_echo_filter(out.fd(), identifier, 1)) {
+         // Sem filtro continua funcionando; só filtra em espaço de usuário
+         std::cerr << "Aviso: filtro BPF não instalado: " << strerror(errno) << std::endl;
+     }
+     return true;
+ }
+
+ // TTL (IPv4) ou hop limit (IPv6) recebido por cmsg; -1 se ausente
+ int received_hop_limit(const msghdr& message) {
+     for (const cmsghdr* cmsg = CMSG_FIRSTHDR(&message); cmsg;
+          cmsg = CMSG_NXTHDR(const_cast<msghdr*>(&message), const_cast<cmsghdr*>(cmsg))) {
+         if ((cmsg->cmsg_level == IPPROTO_IP && cmsg->cmsg_type == IP_TTL) ||
+             (cmsg->cmsg_level == IPPROTO_IPV6 && cmsg->cmsg_type == IPV6_HOPLIMIT)) {
+             int value;
+             memcpy(&value, CMSG_DATA(cmsg), sizeof(value));
+             return value;
+         }
+     }
+     return -1;
+ }
+
  // --- Executa um único ping ---
- PingResult send_ping(int sock, const sockaddr_in& dest,
-                     uint16_t identifier, uint16_t sequence) {
+ PingResult send_ping(const IcmpSocket& sock, const sockaddr_storage& dest, socklen_t dest_len,
+                     uint16_t sequence) {
      PingResult result{};
+     uint16_t identifier = sock.identifier;
      result.sequence = sequence;
      result.identifier = identifier;
 
-     // Prepara payload com timestamp para RTT preciso
-     auto send_time = std::chrono::steady_clock::now();
-     std::string payload = "PING_PAYLOAD_" + std::to_string(sequence);
+     // Payload: timestamp (preenchido no último instante) + texto identificador.
+     // Em ICMPv6 o checksum inclui o pseudo-header e é sempre calculado pelo kernel.
+     std::string payload = std::string(TIMESTAMP_SIZE, '\0') + "PING_PAYLOAD_" + std::to_string(sequence);
+     EchoTemplate echo(payload, sock.request_type());
+     std::vector<uint8_t> packet(echo.size());
+     echo.copy_to(packet.data());
 
-     // Cria pacote ICMP
-     auto packet = create_icmp_echo_request(identifier, sequence, payload);
+     // Timestamp gravado imediatamente antes do envio, com checksum incremental
+     auto send_time = std::chrono::steady_clock::now();
+     echo.stamp(packet.data(), identifier, sequence, clock_now_ns(CLOCK_MONOTONIC));
 
      // Envia pacote
-     ssize_t sent = sendto(sock, packet.data(), packet.size(), 0,
-                          reinterpret_cast<const sockaddr*>(&dest), sizeof(dest));
+     ssize_t sent = sendto(sock.fd(), packet.data(), packet.size(), 0,
+                          reinterpret_cast<const sockaddr*>(&dest), dest_len);
      if (sent <= 0) {
          std::cerr << "Erro no envio: " << strerror(errno) << std::endl;
          return result;
      }
 
-     // Aguarda resposta com timeout
-     fd_set read_set;
-     FD_ZERO(&read_set);
-     FD_SET(sock, &read_set);
+     // Aguarda a resposta até o prazo. Com o filtro BPF chegam só Echo Replies
+     // com o nosso ID; a validação abaixo continua valendo para sequência, origem
+     // e para o caso de o filtro não ter sido instalado.
+     auto deadline = send_time + std::chrono::seconds(TIMEOUT_SECONDS);
+     uint8_t buffer[BUFFER_SIZE];
+     alignas(cmsghdr) uint8_t control[256];
+     sockaddr_storage from{};
+     msghdr message{};
+     ssize_t received = 0;
+     size_t ip_header_len = 0;
+     uint64_t recv_ns = 0;
 
-     timeval timeout{TIMEOUT_SECONDS, 0};
-     int ready = select(sock + 1, &read_set, nullptr, nullptr, &timeout);
+     while (true) {
+         auto remaining = std::chrono::duration_cast<std::chrono::microseconds>(
+             deadline - std::chrono::steady_clock::now());
+         if (remaining.count() <= 0) {
+             std::cout << "Timeout para sequência " << sequence << std::endl;
+             return result;
+         }
 
-     if (ready <= 0) {
+         fd_set read_set;
+         FD_ZERO(&read_set);
+         FD_SET(sock.fd(), &read_set);
+
+         timeval timeout{static_cast<time_t>(remaining.count() / 1000000),
+                         static_cast<suseconds_t>(remaining.count() % 1000000)};
+         int ready = select(sock.fd() + 1, &read_set, nullptr, nullptr, &timeout);
+         if (ready < 0) {
+             if (errno == EINTR) {
+                 continue;
+             }
+             std::cerr << "Erro no select: " << strerror(errno) << std::endl;
+             return result;
+         }
          if (ready == 0) {
-             std::cout << "Timeout para sequência " << sequence << std::endl;
+             continue;
+         }
+
+         // Recebe resposta (com cmsg de TTL/hop limit quando não há header IP)
+         iovec vector{buffer, sizeof(buffer)};
+         message = msghdr{};
+         message.msg_name = &from;
+         message.msg_namelen = sizeof(from);
+         message.msg_iov = &vector;
+         message.msg_iovlen = 1;
+         message.msg_control = control;
+         message.msg_controllen = sizeof(control);
+         received = recvmsg(sock.fd(), &message, 0);
+         if (received <= 0) {
+             std::cerr << "Erro na recepção: " << strerror(errno) << std::endl;
+             return result;
+         }
+
+         recv_ns = clock_now_ns(CLOCK_MONOTONIC);
+
+         // Processa resposta
+         ip_header_len = sock.has_ip_header() ? get_ip_header_length(buffer) : 0;
+         if (received < static_cast<ssize_t>(ip_header_len + sizeof(icmphdr))) {
+             continue;
+         }
+
+         // Extrai header ICMP e confere se é a resposta deste probe
+         struct icmphdr* icmp_response = reinterpret_cast<struct icmphdr*>(buffer + ip_header_len);
+         if (validate_icmp_response(icmp_response, identifier, sequence, sock.reply_type()) &&
+             same_address(from, dest)) {
+             break;
+         }
+     }
+
+     // Preenche resultado: RTT a partir do timestamp que voltou no eco
+     result.success = true;
+     uint64_t sent_ns = 0;
+     const struct icmphdr* reply = reinterpret_cast<const struct icmphdr*>(buffer + ip_header_len);
+     if (read_payload_timestamp(reply, received - ip_header_len, sent_ns) && sent_ns <= recv_ns) {
+         result.rtt_ms = (recv_ns - sent_ns) / 1e6;
+     } else {
+         result.rtt_ms = std::chrono::duration_cast<std::chrono::microseconds>(
+             std::chrono::steady_clock::now() - send_time).count() / 1000.0;
+     }
+
+     result.from_addr = address_to_string(from);
+
+     result.bytes_received = received - ip_header_len - sizeof(icmphdr);
+     // TTL está no offset 8 do header IP; sem header, vem por cmsg
+     result.ttl = sock.has_ip_header() ? buffer[8] : received_hop_limit(message);
+
+     return result;
+ }
+
+ // Socket RAW IPv4 dos modos contínuo, traceroute e PMTU (inválido em caso de erro)
+ Socket open_raw_socket() {
+     Socket sock(socket(AF_INET, SOCK_RAW, IPPROTO_ICMP));
+     if (!sock) {
+         std::cerr << "Erro ao criar socket RAW: " << strerror(errno) << std::endl;
+         std::cerr << "Execute com privilégios de root (sudo)" << std::endl;
+     }
+     return sock;
+ }
+
+ // --- Modo contínuo multi-destino ---
+
+ // Opções do modo contínuo (estilo fping)
+ struct PingOptions {
+     int count = 0;                          // probes por destino (0 = até Ctrl+C)
+     int interval_ms = 1000;                 // período entre probes do mesmo destino
+     int timeout_ms = TIMEOUT_SECONDS * 1000;
+     size_t payload_size = 56;
+     bool quiet = false;                     // sem mensagens de erro de envio
+     bool verbose = false;                   // uma linha por resposta/timeout
+     TimestampMode timestamps = TimestampMode::USERSPACE;
+     int batch_size = 64;                    // pacotes por sendmmsg/recvmmsg
+ };
+
+ // Contadores de syscalls do modo contínuo
+ struct IoStats {
+     uint64_t send_calls = 0;
+     uint64_t packets_sent = 0;
+     uint64_t receive_calls = 0;
+     uint64_t packets_received = 0;
+     uint64_t largest_receive_batch = 0;
+ };
+
+ // Estatísticas acumuladas por destino
+ struct TargetStats {
+     sockaddr_in address{};
+     std::string name;
+     uint32_t sent = 0;
+     uint32_t received = 0;
+     // RTT em ns, memória fixa por destino (~3% de erro nos percentis)
+     LatencyHistogram<6, 36> rtt;
+     // Jitter (RFC 3550, A.8): média móvel de |RTT_i - RTT_{i-1}|
+     double jitter_ns = 0;
+     uint64_t last_rtt_ns = 0;
+ };
+
+ volatile sig_atomic_t stop_requested = 0;
+
+ // Roda de timers (hashed timing wheel): cada slot cobre TICK e guarda os
+ // probes que vencem nele; agendar e expirar custam O(1) por probe. Timeouts
+ // maiores que a volta completa ficam no slot até a volta certa.
+ template <typename Entry>
+ class TimerWheel {
+ public:
+     using Clock = std::chrono::steady_clock;
+     static constexpr auto TICK = std::chrono::milliseconds(10);
+
+     explicit TimerWheel(size_t slot_count = 1024)
+         : slots(slot_count), origin(Clock::now()) {}
+
+     void schedule(Clock::time_point deadline, const Entry& entry) {
+         uint64_t tick = tick_of(deadline);
+         // Nunca agendar num slot já processado
+         tick = std::max(tick, current_tick);
+         slots[tick % slots.size()].push_back(Slot{tick, entry});
+         count++;
+     }
+
+     // Dispara todas as entradas vencidas até `now`
+     template <typename Callback>
+     void advance(Clock::time_point now, Callback&& expired) {
+         uint64_t target = tick_of(now);
+         for (; current_tick <= target; current_tick++) {
+             auto& slot = slots[current_tick % slots.size()];
+             size_t kept = 0;
+             for (size_t i = 0; i < slot.size(); i++) {
+                 if (slot[i].tick <= target) {
+                     expired(slot[i].entry);
+                     count--;
+                 } else {
+                     slot[kept++] = slot[i];
+                 }
+             }
+             slot.resize(kept);
+             if (current_tick == target) {
+                 // O slot atual pode receber mais entradas: revisitar no próximo advance
+                 break;
+             }
+         }
+     }
+
+     size_t size() const {
+         return count;
+     }
+
+ private:
+     struct Slot {
+         uint64_t tick;
+         Entry entry;
+     };
+
+     std::vector<std::vector<Slot>> slots;
+     Clock::time_point origin;
+     uint64_t current_tick = 0;
+     size_t count = 0;
+
+     uint64_t tick_of(Clock::time_point when) const {
+         if (when <= origin) {
+             return 0;
+         }
+         return std::chrono::duration_cast<std::chrono::milliseconds>(when - origin).count() /
+                TICK.count();
+     }
+ };
+
+ // Envia para todos os destinos por um único socket RAW, com envio e
+ // recepção em threads separadas: uma resposta perdida nunca atrasa os
+ // outros probes. Cada probe recebe um contador de 32 bits que vira
+ // (identificador, sequência): a parte alta soma ao ID do processo, a baixa
+ // é a sequência. As respostas são casadas pela tabela de probes em voo e os
+ // timeouts saem de uma roda de timers.
+ class MultiPinger {
+ public:
+     using Clock = std::chrono::steady_clock;
+
+     // IDs usados pelos probes: base + [0, IDENTIFIER_SPAN), 65536 sequências cada
+     static constexpr uint16_t IDENTIFIER_SPAN = 256;
+
+     MultiPinger(int sock, std::vector<TargetStats>& targets, const PingOptions& options)
+         : sock(sock), targets(targets), options(options),
+           base_identifier(static_cast<uint16_t>(getpid() & 0xFFFF)),
+           payload(std::string(TIMESTAMP_SIZE, '\0') +
+                   std::string(options.payload_size > TIMESTAMP_SIZE ? options.payload_size - TIMESTAMP_SIZE : 0, 'P')),
+           echo(payload), clock(timestamp_clock(options.timestamps)),
+           batch(std::max(1, options.batch_size)),
+           send_ring(batch * BUFFER_SIZE), send_messages(batch), send_vectors(batch),
+           receive_ring(batch * BUFFER_SIZE), receive_messages(batch), receive_vectors(batch),
+           receive_addresses(batch), receive_control(batch * CONTROL_SIZE),
+           slot_identifiers(batch), slot_sequences(batch) {
+         // Descritores fixos apontando para os slots dos anéis
+         for (size_t i = 0; i < batch; i++) {
+             send_vectors[i].iov_base = &send_ring[i * BUFFER_SIZE];
+             send_vectors[i].iov_len = echo.size();
+             echo.copy_to(&send_ring[i * BUFFER_SIZE]);
+             send_messages[i].msg_hdr.msg_iov = &send_vectors[i];
+             send_messages[i].msg_hdr.msg_iovlen = 1;
+
+             receive_vectors[i].iov_base = &receive_ring[i * BUFFER_SIZE];
+             receive_vectors[i].iov_len = BUFFER_SIZE;
+             receive_messages[i].msg_hdr.msg_iov = &receive_vectors[i];
+             receive_messages[i].msg_hdr.msg_iovlen = 1;
+             receive_messages[i].msg_hdr.msg_name = &receive_addresses[i];
+             receive_messages[i].msg_hdr.msg_control = &receive_control[i * CONTROL_SIZE];
+         }
+
+         // Probes em voo: taxa de envio × timeout, com folga
+         double rate = targets.size() * 1000.0 / std::max(options.interval_ms, 1);
+         pending.reserve(static_cast<size_t>(rate * options.timeout_ms / 1000.0) + 1024);
+     }
+
+     void run() {
+         std::thread sender([this] { send_loop(); });
+         receive_loop();
+         sender.join();
+     }
+
+     const IoStats& io_stats() const {
+         return io;
+     }
+
+ private:
+     struct PendingProbe {
+         uint32_t target;
+         Clock::time_point sent_at;
+     };
+
+     struct Expiry {
+         uint32_t key;
+         Clock::time_point sent_at;
+     };
+
+     int sock;
+     std::vector<TargetStats>& targets;
+     PingOptions options;
+     uint16_t base_identifier;
+     std::string payload;
+     EchoTemplate echo;
+     clockid_t clock;
+     uint32_t counter = 0;
+
+     // Protege pending, wheel e as estatísticas dos destinos
+     std::mutex mutex;
+     std::unordered_map<uint32_t, PendingProbe> pending;
+     TimerWheel<Expiry> wheel;
+     std::atomic<bool> sending{true};
+
+     // Anéis pré-alocados de `batch` slots de BUFFER_SIZE para envio e recepção
+     size_t batch;
+     std::vector<uint8_t> send_ring;
+     std::vector<mmsghdr> send_messages;
+     std::vector<iovec> send_vectors;
+     std::vector<uint8_t> receive_ring;
+     std::vector<mmsghdr> receive_messages;
+     std::vector<iovec> receive_vectors;
+     std::vector<sockaddr_in> receive_addresses;
+     // Espaço para o cmsg de SO_TIMESTAMPING de cada slot
+     static constexpr size_t CONTROL_SIZE = CMSG_SPACE(sizeof(scm_timestamping)) + 64;
+     std::vector<uint8_t> receive_control;
+     std::vector<uint16_t> slot_identifiers;
+     std::vector<uint16_t> slot_sequences;
+     IoStats io;
+
+     Clock::duration timeout() const {
+         return std::chrono::milliseconds(options.timeout_ms);
+     }
+
+     static uint32_t probe_key(uint16_t identifier, uint16_t sequence) {
+         return (static_cast<uint32_t>(identifier) << 16) | sequence;
+     }
+
+     void send_loop() {
+         // Envios espalhados ao longo do período para não gerar rajadas
+         auto gap = std::chrono::microseconds(
+             static_cast<int64_t>(options.interval_ms) * 1000 / std::max<size_t>(targets.size(), 1));
+         auto next_send = Clock::now();
+         size_t next_target = 0;
+         uint32_t rounds = 0;
+
+         while (!stop_requested && (options.count == 0 || rounds < static_cast<uint32_t>(options.count))) {
+             std::this_thread::sleep_until(next_send);
+             auto now = Clock::now();
+
+             // Envia o que está atrasado, até `batch` probes por sendmmsg
+             size_t queued = 0;
+             while (next_send <= now && queued < batch) {
+                 queue_probe(queued++, next_target, now);
+                 next_send += gap;
+                 if (++next_target == targets.size()) {
+                     next_target = 0;
+                     if (options.count != 0 && ++rounds >= static_cast<uint32_t>(options.count)) {
+                         break;
+                     }
+                 }
+             }
+             flush(queued);
+         }
+         sending = false;
+     }
+
+     // Prepara o probe no slot `slot` do anel de envio e o registra como em voo
+     void queue_probe(size_t slot, size_t index, Clock::time_point now) {
+         uint32_t probe = counter++;
+         uint16_t identifier = static_cast<uint16_t>(base_identifier + ((probe >> 16) % IDENTIFIER_SPAN));
+         uint16_t sequence = static_cast<uint16_t>(probe & 0xFFFF);
+         uint32_t key = probe_key(identifier, sequence);
+         TargetStats& target = targets[index];
+
+         // Slot já contém o modelo; header e timestamp são gravados no flush
+         slot_identifiers[slot] = identifier;
+         slot_sequences[slot] = sequence;
+         send_messages[slot].msg_hdr.msg_name = &target.address;
+         send_messages[slot].msg_hdr.msg_namelen = sizeof(target.address);
+
+         // Registrar antes de enviar: a resposta pode chegar antes do sendmmsg voltar
+         std::lock_guard<std::mutex> lock(mutex);
+         pending[key] = PendingProbe{static_cast<uint32_t>(index), now};
+         wheel.schedule(now + timeout(), Expiry{key, now});
+         target.sent++;
+     }
+
+     // Envia os `count` primeiros slots; sendmmsg pode enviar só parte deles
+     void flush(size_t count) {
+         // Timestamp o mais perto possível do syscall
+         uint64_t now_ns = clock_now_ns(clock);
+         for (size_t i = 0; i < count; i++) {
+             echo.stamp(static_cast<uint8_t*>(send_vectors[i].iov_base),
+                        slot_identifiers[i], slot_sequences[i], now_ns);
+         }
+
+         size_t offset = 0;
+         while (offset < count) {
+             int sent = sendmmsg(sock, &send_messages[offset], count - offset, 0);
+             io.send_calls++;
+             if (sent < 0) {
+                 if (errno == EINTR) {
+                     continue;
+                 }
+                 // Erro no primeiro pacote restante: descartá-lo (vira timeout) e seguir
+                 if (!options.quiet) {
+                     auto* address = static_cast<sockaddr_in*>(send_messages[offset].msg_hdr.msg_name);
+                     char name[INET_ADDRSTRLEN];
+                     inet_ntop(AF_INET, &address->sin_addr, name, sizeof(name));
+                     std::cerr << name << " : erro no envio: " << strerror(errno) << std::endl;
+                 }
+                 offset++;
+                 continue;
+             }
+             io.packets_sent += sent;
+             offset += sent;
+         }
+     }
+
+     void receive_loop() {
+         while (!stop_requested) {
+             {
+                 std::lock_guard<std::mutex> lock(mutex);
+                 expire(Clock::now());
+                 if (!sending && pending.empty()) {
+                     break;
+                 }
+             }
+
+             // Acorda a cada tick da roda para processar timeouts
+             struct pollfd pfd{sock, POLLIN, 0};
+             if (poll(&pfd, 1, static_cast<int>(TimerWheel<Expiry>::TICK.count())) <= 0) {
+                 continue;
+             }
+
+             // Esvaziar a fila do socket em lotes
+             while (true) {
+                 for (size_t i = 0; i < batch; i++) {
+                     receive_messages[i].msg_hdr.msg_namelen = sizeof(sockaddr_in);
+                     receive_messages[i].msg_hdr.msg_controllen = CONTROL_SIZE;
+                 }
+                 int received = recvmmsg(sock, receive_messages.data(), batch, MSG_DONTWAIT, nullptr);
+                 io.receive_calls++;
+                 if (received <= 0) {
+                     break;
+                 }
+                 io.packets_received += received;
+                 io.largest_receive_batch = std::max<uint64_t>(io.largest_receive_batch, received);
+
+                 uint64_t now_ns = clock_now_ns(clock);
+                 std::lock_guard<std::mutex> lock(mutex);
+                 for (int i = 0; i < received; i++) {
+                     uint64_t arrival = kernel_receive_time(receive_messages[i].msg_hdr);
+                     handle_packet(static_cast<const uint8_t*>(receive_vectors[i].iov_base),
+                                   receive_messages[i].msg_len, receive_addresses[i],
+                                   arrival ? arrival : now_ns);
+                 }
+                 if (static_cast<size_t>(received) < batch) {
+                     break;
+                 }
+             }
+         }
+     }
+
+     // Chamado com o mutex travado
+     void handle_packet(const uint8_t* buffer, ssize_t received, const sockaddr_in& from,
+                        uint64_t arrival_ns) {
+         size_t ip_header_len = get_ip_header_length(buffer);
+         if (received < static_cast<ssize_t>(ip_header_len + sizeof(icmphdr))) {
+             return;
+         }
+
+         // Procurar o probe pelo (id, seq); sem filtro BPF, chega todo ICMP do host
+         const struct icmphdr* icmp_response =
+             reinterpret_cast<const struct icmphdr*>(buffer + ip_header_len);
+         uint16_t identifier = ntohs(icmp_response->un.echo.id);
+         uint16_t sequence = ntohs(icmp_response->un.echo.sequence);
+         if (!validate_icmp_response(icmp_response, identifier, sequence)) {
+             return;
+         }
+
+         auto it = pending.find(probe_key(identifier, sequence));
+         if (it == pending.end()) {
+             return;
+         }
+         TargetStats& target = targets[it->second.target];
+         if (from.sin_addr.s_addr != target.address.sin_addr.s_addr) {
+             return;
+         }
+
+         // RTT pelo timestamp do próprio pacote; sem ele (payload truncado), pelo registro local
+         uint64_t sent_ns = 0;
+         uint64_t rtt_ns;
+         if (read_payload_timestamp(icmp_response, received - ip_header_len, sent_ns) &&
+             sent_ns <= arrival_ns) {
+             rtt_ns = arrival_ns - sent_ns;
          } else {
-             std::cerr << "Erro no select: " << strerror(errno) << std::endl;
+             rtt_ns = std::chrono::duration_cast<std::chrono::nanoseconds>(
+                 Clock::now() - it->second.sent_at).count();
+         }
+         pending.erase(it);
+
+         if (target.received > 0) {
+             double delta = std::abs(static_cast<double>(rtt_ns) - static_cast<double>(target.last_rtt_ns));
+             target.jitter_ns += (delta - target.jitter_ns) / 16;
+         }
+         target.last_rtt_ns = rtt_ns;
+         target.rtt.record(rtt_ns);
+         target.received++;
+
+         if (options.verbose) {
+             std::cout << target.name << " : [" << sequence << "], "
+                       << received - ip_header_len - sizeof(icmphdr) << " bytes, TTL=" << int(buffer[8])
+                       << ", " << std::fixed << std::setprecision(3) << rtt_ns / 1e6 << " ms\n";
          }
-         return result;
      }
 
-     // Recebe resposta
+     // Chamado com o mutex travado
+     void expire(Clock::time_point now) {
+         wheel.advance(now, [&](const Expiry& expiry) {
+             auto it = pending.find(expiry.key);
+             // A chave pode já ter sido respondida (ou reusada por um probe mais novo)
+             if (it != pending.end() && it->second.sent_at == expiry.sent_at) {
+                 if (options.verbose) {
+                     std::cout << targets[it->second.target].name << " : timeout ["
+                               << (expiry.key & 0xFFFF) << "]\n";
+                 }
+                 pending.erase(it);
+             }
+         });
+     }
+ };
+
+ void print_io_stats(const IoStats& io) {
+     std::cout << "sendmmsg: " << io.send_calls << " chamadas, " << io.packets_sent << " pacotes ("
+               << std::fixed << std::setprecision(1)
+               << (io.send_calls ? double(io.packets_sent) / io.send_calls : 0.0) << "/chamada); "
+               << "recvmmsg: " << io.receive_calls << " chamadas, " << io.packets_received << " pacotes ("
+               << (io.receive_calls ? double(io.packets_received) / io.receive_calls : 0.0)
+               << "/chamada, maior lote " << io.largest_receive_batch << ")" << std::endl;
+ }
+
+ void print_summary(const std::vector<TargetStats>& targets) {
+     std::cout << std::endl;
+     for (const TargetStats& target : targets) {
+         uint32_t loss = target.sent ? (target.sent - target.received) * 100 / target.sent : 0;
+         std::cout << target.name << " : xmt/rcv/%loss = " << target.sent << "/"
+                   << target.received << "/" << loss << "%";
+         if (target.received > 0) {
+             const auto& rtt = target.rtt;
+             std::cout << std::fixed << std::setprecision(3)
+                       << ", min/avg/max = " << rtt.min() / 1e6 << "/" << rtt.mean() / 1e6 << "/"
+                       << rtt.max() / 1e6
+                       << ", p50/p99/p99.9 = " << rtt.percentile(50) / 1e6 << "/"
+                       << rtt.percentile(99) / 1e6 << "/" << rtt.percentile(99.9) / 1e6
+                       << ", jitter = " << target.jitter_ns / 1e6 << " ms";
+         }
+         std::cout << std::endl;
+     }
+ }
+
+ bool add_target(std::vector<TargetStats>& targets, const std::string& name) {
+     TargetStats target;
+     target.name = name;
+     target.address.sin_family = AF_INET;
+     if (inet_pton(AF_INET, name.c_str(), &target.address.sin_addr) != 1) {
+         std::cerr << "Endereço IP inválido: " << name << std::endl;
+         return false;
+     }
+     targets.push_back(target);
+     return true;
+ }
+
+ int run_continuous(int argc, char* argv[]) {
+     PingOptions options;
+     std::vector<TargetStats> targets;
+
+     for (int i = 1; i < argc; i++) {
+         std::string arg = argv[i];
+         if ((arg == "-c" || arg == "-i" || arg == "-t" || arg == "-s" || arg == "-f" || arg == "-b" ||
+              arg == "-T") &&
+             i + 1 < argc) {
+             std::string value = argv[++i];
+             if (arg == "-c") options.count = std::atoi(value.c_str());
+             else if (arg == "-i") options.interval_ms = std::max(1, std::atoi(value.c_str()));
+             else if (arg == "-T") {
+                 if (value == "sw" || value == "hw") options.timestamps = TimestampMode::SOFTWARE;
+                 else options.timestamps = TimestampMode::USERSPACE;
+                 if (value == "hw") {
+                     std::cerr << "Aviso: -T hw não é suportado, usando timestamps do kernel (sw)" << std::endl;
+                 }
+             }
+             else if (arg == "-b") options.batch_size = std::max(1, std::min(std::atoi(value.c_str()), 1024));
+             else if (arg == "-t") options.timeout_ms = std::max(1, std::atoi(value.c_str()));
+             else if (arg == "-s") options.payload_size = std::max(0, std::min(std::atoi(value.c_str()), BUFFER_SIZE - 28 - 8));
+             else {
+                 std::ifstream file(value);
+                 std::string line;
+                 while (std::getline(file, line)) {
+                     if (!line.empty() && line[0] != '#' && !add_target(targets, line)) {
+                         return 1;
+                     }
+                 }
+             }
+         } else if (arg == "-q") {
+             options.quiet = true;
+         } else if (arg == "-v") {
+             options.verbose = true;
+         } else if (!add_target(targets, arg)) {
+             return 1;
+         }
+     }
+
+     if (targets.empty()) {
+         std::cerr << "Nenhum destino informado" << std::endl;
+         return 1;
+     }
+
+     Socket sock = open_raw_socket();
+     if (!sock) {
+         return 1;
+     }
+
+     if (!attach_echo_filter(sock.fd(), static_cast<uint16_t>(getpid() & 0xFFFF), MultiPinger::IDENTIFIER_SPAN)) {
+         std::cerr << "Aviso: filtro BPF não instalado: " << strerror(errno) << std::endl;
+     }
+
+     // Buffer de recepção grande: rajadas de respostas de milhares de destinos
+     int rcvbuf = 4 * 1024 * 1024;
+     setsockopt(sock.fd(), SOL_SOCKET, SO_RCVBUF, &rcvbuf, sizeof(rcvbuf));
+
+     if (!enable_kernel_timestamps(sock.fd(), options.timestamps)) {
+         std::cerr << "SO_TIMESTAMPING indisponível (" << strerror(errno)
+                   << "), usando timestamps do processo" << std::endl;
+         options.timestamps = TimestampMode::USERSPACE;
+     }
+
+     std::signal(SIGINT, [](int) { stop_requested = 1; });
+
+     MultiPinger pinger(sock.fd(), targets, options);
+     pinger.run();
+     sock.reset();
+
+     print_summary(targets);
+     print_io_stats(pinger.io_stats());
+
+     bool any_reply = false;
+     for (const TargetStats& target : targets) {
+         any_reply = any_reply || target.received > 0;
+     }
+     return any_reply ? 0 : 1;
+ }
+
+ // --- Traceroute paralelo e descoberta de PMTU ---
+
+ // Resposta a um probe Echo: Echo Reply do destino ou erro ICMP de um roteador
+ struct ProbeReply {
+     uint8_t type;
+     uint8_t code;
+     uint16_t identifier;
+     uint16_t sequence;
+     in_addr probed;          // destino original do probe
+     uint16_t next_hop_mtu;   // Fragmentation Needed (RFC 1191), 0 se ausente
+ };
+
+ // Erros ICMP carregam o header IP original + ao menos 8 bytes: o bastante para
+ // recuperar o header Echo do probe e casar a resposta por (id, seq).
+ bool parse_probe_reply(const uint8_t* packet, size_t length, ProbeReply& reply) {
+     size_t ip_header_len = get_ip_header_length(packet);
+     if (length < ip_header_len + sizeof(icmphdr)) {
+         return false;
+     }
+     const struct icmphdr* icmp = reinterpret_cast<const struct icmphdr*>(packet + ip_header_len);
+     reply.type = icmp->type;
+     reply.code = icmp->code;
+     reply.next_hop_mtu = 0;
+
+     const struct icmphdr* echo = icmp;
+     if (icmp->type == ICMP_TIME_EXCEEDED || icmp->type == ICMP_DEST_UNREACH) {
+         const uint8_t* inner = packet + ip_header_len + sizeof(icmphdr);
+         size_t inner_len = length - ip_header_len - sizeof(icmphdr);
+         if (inner_len < 20) {
+             return false;
+         }
+         size_t inner_header_len = get_ip_header_length(inner);
+         if (inner_len < inner_header_len + sizeof(icmphdr) || inner[9] != IPPROTO_ICMP) {
+             return false;
+         }
+         echo = reinterpret_cast<const struct icmphdr*>(inner + inner_header_len);
+         if (echo->type != ICMP_ECHO) {
+             return false;
+         }
+         memcpy(&reply.probed, inner + 16, sizeof(reply.probed));
+         if (icmp->type == ICMP_DEST_UNREACH && icmp->code == ICMP_FRAG_NEEDED) {
+             reply.next_hop_mtu = ntohs(icmp->un.frag.mtu);
+         }
+     } else if (icmp->type == ICMP_ECHOREPLY) {
+         memcpy(&reply.probed, packet + 12, sizeof(reply.probed));
+     } else {
+         return false;
+     }
+
+     reply.identifier = ntohs(echo->un.echo.id);
+     reply.sequence = ntohs(echo->un.echo.sequence);
+     return true;
+ }
+
+ // Espera dados no socket até o prazo; false se o prazo venceu
+ bool wait_readable(int sock, std::chrono::steady_clock::time_point deadline) {
+     while (true) {
+         auto remaining = std::chrono::duration_cast<std::chrono::milliseconds>(
+             deadline - std::chrono::steady_clock::now()).count();
+         if (remaining <= 0) {
+             return false;
+         }
+         pollfd descriptor{sock, POLLIN, 0};
+         int ready = poll(&descriptor, 1, static_cast<int>(remaining));
+         if (ready > 0) {
+             return true;
+         }
+         if (ready < 0 && errno != EINTR) {
+             return false;
+         }
+     }
+ }
+
+ struct TraceOptions {
+     int max_hops = 30;
+     int queries = 3;          // probes por salto
+     int timeout_ms = 2000;
+ };
+
+ struct HopProbe {
+     uint64_t sent_ns = 0;
+     double rtt_ms = -1;       // < 0: sem resposta
+     in_addr from{};
+     uint8_t type = 0;
+     uint8_t code = 0;
+ };
+
+ // Todos os TTLs saem de uma vez; as respostas de cada salto chegam em paralelo
+ // e o trace leva ~1 RTT + timeout dos saltos mudos, não a soma dos saltos.
+ int run_traceroute(const sockaddr_in& dest, const TraceOptions& options) {
+     Socket sock = open_raw_socket();
+     if (!sock) {
+         return 1;
+     }
+
+     uint16_t identifier = static_cast<uint16_t>(getpid() & 0xFFFF);
+     size_t total = static_cast<size_t>(options.max_hops) * options.queries;
+     std::vector<HopProbe> probes(total);
+     EchoTemplate echo(std::string(TIMESTAMP_SIZE, '\0') + "TRACE");
+     std::vector<uint8_t> packet(echo.size());
+     echo.copy_to(packet.data());
+
+     auto start = std::chrono::steady_clock::now();
+     for (size_t index = 0; index < total; index++) {
+         int ttl = static_cast<int>(index / options.queries) + 1;
+         setsockopt(sock.fd(), IPPROTO_IP, IP_TTL, &ttl, sizeof(ttl));
+         probes[index].sent_ns = clock_now_ns(CLOCK_MONOTONIC);
+         echo.stamp(packet.data(), identifier, static_cast<uint16_t>(index), probes[index].sent_ns);
+         if (sendto(sock.fd(), packet.data(), packet.size(), 0,
+                    reinterpret_cast<const sockaddr*>(&dest), sizeof(dest)) < 0) {
+             std::cerr << "Erro no envio (TTL " << ttl << "): " << strerror(errno) << std::endl;
+         }
+     }
+
+     // Coleta até o prazo ou até todos os saltos até o destino responderem
+     int destination_hop = options.max_hops + 1;
+     auto deadline = std::chrono::steady_clock::now() + std::chrono::milliseconds(options.timeout_ms);
      uint8_t buffer[BUFFER_SIZE];
-     sockaddr_in from{};
-     socklen_t from_len = sizeof(from);
+     while (wait_readable(sock.fd(), deadline)) {
+         ssize_t received = recv_some(sock.fd(), buffer, sizeof(buffer));
+         uint64_t now_ns = clock_now_ns(CLOCK_MONOTONIC);
+         ProbeReply reply;
+         if (received <= 0 || !parse_probe_reply(buffer, received, reply) ||
+             reply.identifier != identifier || reply.sequence >= total ||
+             reply.probed.s_addr != dest.sin_addr.s_addr) {
+             continue;
+         }
 
-     ssize_t received = recvfrom(sock, buffer, sizeof(buffer), 0,
-                                reinterpret_cast<sockaddr*>(&from), &from_len);
-     if (received <= 0) {
-         std::cerr << "Erro na recepção: " << strerror(errno) << std::endl;
-         return result;
+         HopProbe& probe = probes[reply.sequence];
+         if (probe.rtt_ms >= 0) {
+             continue;
+         }
+         probe.rtt_ms = (now_ns - probe.sent_ns) / 1e6;
+         memcpy(&probe.from, buffer + 12, sizeof(probe.from));
+         probe.type = reply.type;
+         probe.code = reply.code;
+
+         int hop = static_cast<int>(reply.sequence / options.queries) + 1;
+         if (reply.type != ICMP_TIME_EXCEEDED) {
+             destination_hop = std::min(destination_hop, hop);
+         }
+
+         size_t needed = static_cast<size_t>(std::min(destination_hop, options.max_hops)) * options.queries;
+         bool complete = true;
+         for (size_t i = 0; i < needed && complete; i++) {
+             complete = probes[i].rtt_ms >= 0;
+         }
+         if (complete && destination_hop <= options.max_hops) {
+             break;
+         }
      }
+     sock.reset();
 
-     auto recv_time = std::chrono::steady_clock::now();
+     // Uma linha por salto; o endereço só é repetido quando muda dentro do salto
+     int last_hop = std::min(destination_hop, options.max_hops);
+     for (int hop = 1; hop <= last_hop; hop++) {
+         std::cout << std::setw(2) << std::right << hop << " ";
+         in_addr_t shown = 0;
+         for (int query = 0; query < options.queries; query++) {
+             const HopProbe& probe = probes[(hop - 1) * options.queries + query];
+             if (probe.rtt_ms < 0) {
+                 std::cout << " *";
+                 continue;
+             }
+             if (probe.from.s_addr != shown) {
+                 char name[INET_ADDRSTRLEN];
+                 inet_ntop(AF_INET, &probe.from, name, sizeof(name));
+                 std::cout << "  " << name;
+                 shown = probe.from.s_addr;
+             }
+             std::cout << "  " << std::fixed << std::setprecision(3) << probe.rtt_ms << " ms";
+             if (probe.type == ICMP_DEST_UNREACH) {
+                 std::cout << " !" << int(probe.code);
+             }
+         }
+         std::cout << "\n";
+     }
 
-     // Processa resposta
-     size_t ip_header_len = get_ip_header_length(buffer);
+     double elapsed = std::chrono::duration_cast<std::chrono::microseconds>(
+         std::chrono::steady_clock::now() - start).count() / 1000.0;
+     std::cout << "Traceroute concluído em " << std::fixed << std::setprecision(1) << elapsed << " ms"
+               << (destination_hop <= options.max_hops ? "" : " (destino não alcançado)") << std::endl;
+     return destination_hop <= options.max_hops ? 0 : 1;
+ }
 
-     if (received < static_cast<ssize_t>(ip_header_len + sizeof(icmphdr))) {
-         std::cerr << "Pacote recebido muito curto" << std::endl;
-         return result;
+ // Busca do MTU do caminho com DF: a cada rodada, PMTU_PROBES tamanhos entre o
+ // maior que passou e o menor que falhou saem juntos. "Fragmentation Needed"
+ // com next-hop MTU encurta a busca; timeout conta como grande demais (buraco negro).
+ constexpr int PMTU_PROBES = 8;
+ constexpr int IPV4_MIN_MTU = 68;
+ constexpr int IP_ICMP_HEADERS = 20 + sizeof(icmphdr);
+
+ int run_pmtu(const sockaddr_in& dest, int timeout_ms) {
+     Socket sock = open_raw_socket();
+     if (!sock) {
+         return 1;
      }
 
-     // Extrai header ICMP
-     struct icmphdr* icmp_response = reinterpret_cast<struct icmphdr*>(buffer + ip_header_len);
+     // DF em todos os pacotes, sem fragmentação local e ignorando o PMTU em cache
+     int discover = IP_PMTUDISC_PROBE;
+     setsockopt(sock.fd(), IPPROTO_IP, IP_MTU_DISCOVER, &discover, sizeof(discover));
 
-     // Valida resposta
-     if (!validate_icmp_response(icmp_response, identifier, sequence)) {
-         std::cout << "Resposta ICMP inválida ou não esperada" << std::endl;
-         return result;
+     // Uma rodada pode devolver PMTU_PROBES respostas de até 64 KB de uma vez
+     int rcvbuf = 4 * 1024 * 1024;
+     setsockopt(sock.fd(), SOL_SOCKET, SO_RCVBUF, &rcvbuf, sizeof(rcvbuf));
+
+     // Limite superior inicial: MTU da rota (socket UDP conectado, nada é enviado)
+     int high = 65535;
+     Socket route(socket(AF_INET, SOCK_DGRAM, 0));
+     int mtu = 0;
+     socklen_t mtu_len = sizeof(mtu);
+     if (route && connect(route.fd(), reinterpret_cast<const sockaddr*>(&dest), sizeof(dest)) == 0 &&
+         getsockopt(route.fd(), IPPROTO_IP, IP_MTU, &mtu, &mtu_len) == 0 && mtu > 0) {
+         high = std::min(high, mtu);
      }
 
-     // Preenche resultado
-     result.success = true;
-     result.rtt_ms = std::chrono::duration_cast<std::chrono::microseconds>(
-         recv_time - send_time).count() / 1000.0;
+     uint16_t identifier = static_cast<uint16_t>(getpid() & 0xFFFF);
+     int low = IPV4_MIN_MTU;
+     bool confirmed = false;
+     uint16_t sequence = 0;
+     int rounds = 0;
+     // Respostas de até 64 KB: buffer do pool em vez da pilha
+     BufferPool::Lease lease = BufferPool::shared().acquire(65536);
+     uint8_t* buffer = reinterpret_cast<uint8_t*>(lease.data());
+     auto start = std::chrono::steady_clock::now();
 
-     char addr_str[INET_ADDRSTRLEN];
-     inet_ntop(AF_INET, &from.sin_addr, addr_str, sizeof(addr_str));
-     result.from_addr = addr_str;
+     while (low < high || !confirmed) {
+         // Tamanhos (IP total) distribuídos em (low, high]; na 1ª rodada inclui `high`
+         std::vector<int> sizes;
+         int span = std::max(high - low, 1);
+         for (int i = 1; i <= PMTU_PROBES; i++) {
+             int size = low + (span * i + PMTU_PROBES - 1) / PMTU_PROBES;
+             if (size > IPV4_MIN_MTU && size <= high && (sizes.empty() || sizes.back() != size)) {
+                 sizes.push_back(size);
+             }
+         }
+         if (!confirmed && (sizes.empty() || sizes.front() != low)) {
+             sizes.insert(sizes.begin(), low);
+         }
 
-     result.bytes_received = received - ip_header_len - sizeof(icmphdr);
-     result.ttl = buffer[8]; // TTL está no offset 8 do header IP
+         std::vector<int> outcome(sizes.size(), 0);   // 1 passou, -1 grande demais
+         uint16_t first_sequence = sequence;
+         for (size_t i = 0; i < sizes.size(); i++) {
+             auto probe = create_icmp_echo_request(identifier, sequence++,
+                                                   std::string(sizes[i] - IP_ICMP_HEADERS, 'M'));
+             if (sendto(sock.fd(), probe.data(), probe.size(), 0,
+                        reinterpret_cast<const sockaddr*>(&dest), sizeof(dest)) < 0) {
+                 outcome[i] = -1;   // EMSGSIZE: maior que o MTU local
+             }
+         }
 
-     return result;
+         auto deadline = std::chrono::steady_clock::now() + std::chrono::milliseconds(timeout_ms);
+         size_t pending = std::count(outcome.begin(), outcome.end(), 0);
+         while (pending > 0 && wait_readable(sock.fd(), deadline)) {
+             ssize_t received = recv_some(sock.fd(), buffer, lease.size());
+             ProbeReply reply;
+             if (received <= 0 || !parse_probe_reply(buffer, received, reply) ||
+                 reply.identifier != identifier || reply.probed.s_addr != dest.sin_addr.s_addr) {
+                 continue;
+             }
+             size_t index = static_cast<uint16_t>(reply.sequence - first_sequence);
+             if (index >= sizes.size() || outcome[index] != 0) {
+                 continue;
+             }
+             if (reply.type == ICMP_ECHOREPLY) {
+                 outcome[index] = 1;
+             } else {
+                 outcome[index] = -1;
+                 if (reply.next_hop_mtu >= IPV4_MIN_MTU) {
+                     high = std::min(high, static_cast<int>(reply.next_hop_mtu));
+                 }
+             }
+             pending--;
+         }
+
+         for (size_t i = 0; i < sizes.size(); i++) {
+             if (outcome[i] > 0) {
+                 low = std::max(low, sizes[i]);
+                 confirmed = true;
+             } else {
+                 high = std::min(high, sizes[i] - 1);
+             }
+         }
+         rounds++;
+
+         if (!confirmed && high < IPV4_MIN_MTU) {
+             break;
+         }
+         high = std::max(high, low);
+     }
+     sock.reset();
+
+     double elapsed = std::chrono::duration_cast<std::chrono::microseconds>(
+         std::chrono::steady_clock::now() - start).count() / 1000.0;
+     char name[INET_ADDRSTRLEN];
+     inet_ntop(AF_INET, &dest.sin_addr, name, sizeof(name));
+     if (!confirmed) {
+         std::cout << "PMTU para " << name << ": sem resposta" << std::endl;
+         return 1;
+     }
+     std::cout << "PMTU para " << name << ": " << low << " bytes (" << rounds << " rodadas, "
+               << std::fixed << std::setprecision(1) << elapsed << " ms)" << std::endl;
+     return 0;
+ }
+
+ // --traceroute [-m saltos] [-q probes] [-t ms] <IPv4> | --pmtu [-t ms] <IPv4>
+ int run_path_tool(int argc, char* argv[]) {
+     bool pmtu = std::string(argv[1]) == "--pmtu";
+     TraceOptions options;
+     const char* target = nullptr;
+     for (int i = 2; i < argc; i++) {
+         std::string arg = argv[i];
+         if ((arg == "-m" || arg == "-q" || arg == "-t") && i + 1 < argc) {
+             int value = std::atoi(argv[++i]);
+             if (arg == "-m") options.max_hops = std::max(1, std::min(value, 255));
+             else if (arg == "-q") options.queries = std::max(1, std::min(value, 10));
+             else options.timeout_ms = std::max(1, value);
+         } else {
+             target = argv[i];
+         }
+     }
+
+     sockaddr_in dest{};
+     dest.sin_family = AF_INET;
+     if (!target || inet_pton(AF_INET, target, &dest.sin_addr) != 1) {
+         std::cerr << "Uso: " << argv[0] << " --traceroute [-m saltos] [-q probes] [-t ms] <IPv4>" << std::endl;
+         std::cerr << "     " << argv[0] << " --pmtu [-t ms] <IPv4>" << std::endl;
+         return 1;
+     }
+     return pmtu ? run_pmtu(dest, options.timeout_ms) : run_traceroute(dest, options);
+ }
+
+ // --- Micro-benchmark de checksum ---
+
+ // Compara o laço escalar, a versão vetorial e a atualização incremental
+ // do modelo, conferindo que os três produzem o mesmo checksum
+ int run_checksum_benchmark(int iterations) {
+     std::vector<size_t> sizes = {64, 512, 1472, 9000, 65507};
+     std::cout << std::left << std::setw(8) << "bytes" << std::setw(14) << "escalar ns"
+               << std::setw(14) << "vetorial ns" << std::setw(16) << "incremental ns" << "ok" << std::endl;
+
+     bool all_ok = true;
+     volatile uint16_t sink = 0;
+     for (size_t size : sizes) {
+         std::string payload(size - sizeof(icmphdr), '\0');
+         for (size_t i = 0; i < payload.size(); i++) {
+             payload[i] = static_cast<char>(i * 131 + 7);
+         }
+         EchoTemplate echo(payload);
+         std::vector<uint8_t> packet(echo.size());
+         echo.copy_to(packet.data());
+
+         auto measure = [&](auto&& body) {
+             auto start = std::chrono::steady_clock::now();
+             for (int i = 0; i < iterations; i++) {
+                 body(i);
+             }
+             return std::chrono::duration<double, std::nano>(
+                 std::chrono::steady_clock::now() - start).count() / iterations;
+         };
+
+         double scalar_ns = measure([&](int) { sink = icmp_checksum_scalar(packet.data(), packet.size()); });
+         double vector_ns = measure([&](int) { sink = icmp_checksum(packet.data(), packet.size()); });
+         double incremental_ns = measure([&](int i) {
+             echo.stamp(packet.data(), 0x1234, static_cast<uint16_t>(i));
+             sink = packet[2];
+         });
+
+         // Conferência: checksum incremental == recalculado do zero (que deve dar 0 ao somar)
+         bool ok = true;
+         for (int seq = 0; seq < 1000 && ok; seq++) {
+             echo.stamp(packet.data(), static_cast<uint16_t>(seq * 7919), static_cast<uint16_t>(seq));
+             uint16_t stored;
+             memcpy(&stored, packet.data() + 2, sizeof(stored));
+             packet[2] = packet[3] = 0;
+             ok = icmp_checksum_scalar(packet.data(), packet.size()) == stored &&
+                  icmp_checksum(packet.data(), packet.size()) == stored;
+             memcpy(packet.data() + 2, &stored, sizeof(stored));
+         }
+         for (size_t odd = 1; odd < 40 && ok; odd += 3) {
+             ok = icmp_checksum_scalar(packet.data(), packet.size() - odd) ==
+                  icmp_checksum(packet.data(), packet.size() - odd);
+         }
+         all_ok = all_ok && ok;
+
+         std::cout << std::left << std::setw(8) << size << std::fixed << std::setprecision(1)
+                   << std::setw(14) << scalar_ns << std::setw(14) << vector_ns
+                   << std::setw(16) << incremental_ns << (ok ? "sim" : "NÃO") << std::endl;
+     }
+     return all_ok ? 0 : 1;
  }
 
  // --- Função Principal ---
  int main(int argc, char* argv[]) {
-     if (argc != 2) {
-         std::cerr << "Uso: " << argv[0] << " <endereço_IPv4>" << std::endl;
-         return 1;
+     if (argc >= 2 && std::string(argv[1]) == "--bench-checksum") {
+         return run_checksum_benchmark(argc >= 3 ? std::max(1, std::atoi(argv[2])) : 100000);
      }
 
-     // Configura destino
-     sockaddr_in destino{};
-     destino.sin_family = AF_INET;
+     if (argc >= 2 && (std::string(argv[1]) == "--traceroute" || std::string(argv[1]) == "--pmtu")) {
+         return run_path_tool(argc, argv);
+     }
 
-     if (inet_pton(AF_INET, argv[1], &destino.sin_addr) != 1) {
-         std::cerr << "Endereço IP inválido: " << argv[1] << std::endl;
+     // Backend de socket do ping simples
+     SocketMode mode = SocketMode::AUTO;
+     if (argc == 3 && std::string(argv[1]) == "--dgram") {
+         mode = SocketMode::DATAGRAM;
+     } else if (argc == 3 && std::string(argv[1]) == "--raw") {
+         mode = SocketMode::RAW;
+     }
+     const char* target = mode == SocketMode::AUTO ? argv[1] : argv[2];
+
+     // Vários destinos ou opções: modo contínuo
+     if (mode == SocketMode::AUTO && (argc > 2 || (argc == 2 && argv[1][0] == '-'))) {
+         return run_continuous(argc, argv);
+     }
+
+     if (argc < 2) {
+         std::cerr << "Uso: " << argv[0] << " [--raw|--dgram] <endereço IPv4/IPv6>" << std::endl;
+         std::cerr << "     " << argv[0] << " [-c n] [-i ms] [-t ms] [-s bytes] [-b lote] [-T sw] [-q] [-v] [-f arquivo] <IPv4>..."
+                   << std::endl;
+         std::cerr << "     " << argv[0] << " --traceroute [-m saltos] [-q probes] [-t ms] <IPv4> | --pmtu [-t ms] <IPv4>"
+                   << std::endl;
          return 1;
      }
 
-     // Cria socket RAW
-     int sock = socket(AF_INET, SOCK_RAW, IPPROTO_ICMP);
-     if (sock < 0) {
-         std::cerr << "Erro ao criar socket RAW: " << strerror(errno) << std::endl;
-         std::cerr << "Execute com privilégios de root (sudo)" << std::endl;
+     // Configura destino
+     sockaddr_storage destino{};
+     socklen_t destino_len = 0;
+     if (!parse_address(target, destino, destino_len)) {
+         std::cerr << "Endereço IP inválido: " << target << std::endl;
          return 1;
      }
 
-     // Garante fechamento do socket ao sair
-     auto cleanup = [&]() { close(sock); };
+     // Cria socket (RAW com privilégio, datagrama sem)
+     IcmpSocket sock;
+     if (!open_icmp_socket(destino.ss_family, mode, static_cast<uint16_t>(getpid() & 0xFFFF), sock)) {
+         return 1;
+     }
 
-     std::cout << "PING " << argv[1] << " com ID=" << getpid() << std::endl;
+     std::cout << "PING " << target << " com ID=" << sock.identifier
+               << (sock.datagram ? " (socket datagrama)" : "") << std::endl;
 
      // Executa ping
-     uint16_t identifier = static_cast<uint16_t>(getpid() & 0xFFFF);
-     auto result = send_ping(sock, destino, identifier, DEFAULT_SEQUENCE);
+     auto result = send_ping(sock, destino, destino_len, DEFAULT_SEQUENCE);
 
      // Exibe resultados
      if (result.success) {
@@ -232,9 +1598,8 @@
                    << " tempo=" << std::fixed << std::setprecision(3)
                    << result.rtt_ms << "ms" << std::endl;
      } else {
-         std::cout << "Falha no ping para " << argv[1] << std::endl;
+         std::cout << "Falha no ping para " << target << std::endl;
      }
 
-     cleanup();
      return result.success ? 0 : 1;
  }
@@ -0,0 +1,383 @@
+/*
+ * dns_resolver.h - Resolução de nomes compartilhada pelos clientes HTTP e FTP
+ *
+ * Objetivo: Substituir gethostbyname (bloqueante, não thread-safe, só IPv4 e
+ * sem cache) por getaddrinfo com:
+ *   - Cache com validade (TTL) para respostas positivas e negativas
+ *   - Agrupamento de consultas simultâneas para o mesmo nome (uma só consulta)
+ *   - Interface assíncrona executada por um pool de threads
+ *   - Conexão Happy Eyeballs (RFC 8305): IPv6 e IPv4 em paralelo
+ *
+ * Uso: header-only; incluir e compilar com -pthread
+ */
+
+#ifndef PROTOCOLS_DNS_RESOLVER_H
+#define PROTOCOLS_DNS_RESOLVER_H
+
+#include <algorithm>
+#include <chrono>
+#include <condition_variable>
+#include <cstring>
+#include <deque>
+#include <functional>
+#include <future>
+#include <map>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+#include <arpa/inet.h>
+#include <cerrno>
+#include <fcntl.h>
+#include <netdb.h>
+#include <netinet/in.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+// Endereço resolvido, pronto para connect()
+struct ResolvedAddress {
+    sockaddr_storage addr;
+    socklen_t length;
+    int family;
+
+    std::string to_string() const {
+        char text[INET6_ADDRSTRLEN] = "";
+        if (family == AF_INET) {
+            inet_ntop(AF_INET, &reinterpret_cast<const sockaddr_in*>(&addr)->sin_addr,
+                      text, sizeof(text));
+        } else if (family == AF_INET6) {
+            inet_ntop(AF_INET6, &reinterpret_cast<const sockaddr_in6*>(&addr)->sin6_addr,
+                      text, sizeof(text));
+        }
+        return text;
+    }
+};
+
+class DNSResolver {
+public:
+    using Addresses = std::vector<ResolvedAddress>;
+    // error vazio indica sucesso
+    using Callback = std::function<void(const Addresses& addresses, const std::string& error)>;
+
+    // getaddrinfo não informa o TTL do registro: o cache usa um TTL máximo
+    // configurável (nomes numéricos, como "127.0.0.1", nunca expiram)
+    explicit DNSResolver(std::chrono::seconds ttl = std::chrono::seconds(60),
+                         std::chrono::seconds negative_ttl = std::chrono::seconds(5),
+                         size_t workers = 4)
+        : ttl(ttl), negative_ttl(negative_ttl), max_workers(workers ? workers : 1),
+          stopping(false) {}
+
+    ~DNSResolver() {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            stopping = true;
+        }
+        jobs_ready.notify_all();
+        for (auto& worker : worker_threads) {
+            worker.join();
+        }
+    }
+
+    DNSResolver(const DNSResolver&) = delete;
+    DNSResolver& operator=(const DNSResolver&) = delete;
+
+    // Instância compartilhada pelo processo
+    static DNSResolver& shared() {
+        static DNSResolver resolver;
+        return resolver;
+    }
+
+    void set_ttl(std::chrono::seconds positive, std::chrono::seconds negative) {
+        std::lock_guard<std::mutex> lock(mutex);
+        ttl = positive;
+        negative_ttl = negative;
+    }
+
+    void clear_cache() {
+        std::lock_guard<std::mutex> lock(mutex);
+        cache.clear();
+    }
+
+    // Resolução bloqueante; usa o cache e aguarda uma consulta já em andamento
+    Addresses resolve(const std::string& host, int port, std::string* error = nullptr) {
+        Entry entry = lookup(host);
+        if (error) {
+            *error = entry.error;
+        }
+        return with_port(entry.addresses, port);
+    }
+
+    // Resolução assíncrona: o callback é chamado em uma thread do pool, ou
+    // imediatamente na thread atual se o nome já estiver no cache
+    void resolve_async(const std::string& host, int port, Callback callback) {
+        {
+            std::unique_lock<std::mutex> lock(mutex);
+            auto cached = cache.find(host);
+            if (cached != cache.end() && cached->second.expires_at > Clock::now()) {
+                Entry entry = cached->second;
+                lock.unlock();
+                callback(with_port(entry.addresses, port), entry.error);
+                return;
+            }
+
+            jobs.push_back({host, port, std::move(callback)});
+            if (worker_threads.size() < max_workers) {
+                worker_threads.emplace_back([this]() { worker_loop(); });
+            }
+        }
+        jobs_ready.notify_one();
+    }
+
+private:
+    using Clock = std::chrono::steady_clock;
+
+    struct Entry {
+        Addresses addresses;
+        std::string error;
+        Clock::time_point expires_at;
+    };
+
+    struct Job {
+        std::string host;
+        int port;
+        Callback callback;
+    };
+
+    std::mutex mutex;
+    std::map<std::string, Entry> cache;
+    std::map<std::string, std::shared_future<Entry>> in_flight;
+    std::chrono::seconds ttl;
+    std::chrono::seconds negative_ttl;
+
+    std::deque<Job> jobs;
+    std::condition_variable jobs_ready;
+    std::vector<std::thread> worker_threads;
+    size_t max_workers;
+    bool stopping;
+
+    Entry lookup(const std::string& host) {
+        std::unique_lock<std::mutex> lock(mutex);
+
+        auto cached = cache.find(host);
+        if (cached != cache.end() && cached->second.expires_at > Clock::now()) {
+            return cached->second;
+        }
+
+        // Outra thread já está consultando este nome: aguarda o mesmo resultado
+        auto pending = in_flight.find(host);
+        if (pending != in_flight.end()) {
+            std::shared_future<Entry> future = pending->second;
+            lock.unlock();
+            return future.get();
+        }
+
+        std::promise<Entry> promise;
+        in_flight[host] = promise.get_future().share();
+        lock.unlock();
+
+        bool numeric = false;
+        Entry entry = query(host, numeric);
+
+        lock.lock();
+        auto now = Clock::now();
+        if (numeric) {
+            entry.expires_at = Clock::time_point::max();
+        } else {
+            entry.expires_at = now + (entry.error.empty() ? ttl : negative_ttl);
+        }
+        cache[host] = entry;
+        in_flight.erase(host);
+        lock.unlock();
+
+        promise.set_value(entry);
+        return entry;
+    }
+
+    static Entry query(const std::string& host, bool& numeric) {
+        Entry entry;
+        struct addrinfo hints{};
+        hints.ai_family = AF_UNSPEC;
+        hints.ai_socktype = SOCK_STREAM;
+        hints.ai_flags = AI_ADDRCONFIG;
+
+        struct addrinfo* result = nullptr;
+        int rc = getaddrinfo(host.c_str(), nullptr, &hints, &result);
+        if (rc != 0) {
+            entry.error = "Erro ao resolver host: " + host + " (" + gai_strerror(rc) + ")";
+            numeric = false;
+            return entry;
+        }
+
+        for (struct addrinfo* ai = result; ai; ai = ai->ai_next) {
+            if (ai->ai_family != AF_INET && ai->ai_family != AF_INET6) {
+                continue;
+            }
+            ResolvedAddress address{};
+            memcpy(&address.addr, ai->ai_addr, ai->ai_addrlen);
+            address.length = ai->ai_addrlen;
+            address.family = ai->ai_family;
+            entry.addresses.push_back(address);
+        }
+        freeaddrinfo(result);
+
+        // Nome numérico não depende de DNS: pode ficar no cache indefinidamente
+        unsigned char probe[sizeof(struct in6_addr)];
+        numeric = inet_pton(AF_INET, host.c_str(), probe) == 1 ||
+                  inet_pton(AF_INET6, host.c_str(), probe) == 1;
+
+        if (entry.addresses.empty()) {
+            entry.error = "Nenhum endereço IPv4/IPv6 para " + host;
+        }
+        return entry;
+    }
+
+    static Addresses with_port(Addresses addresses, int port) {
+        for (auto& address : addresses) {
+            if (address.family == AF_INET) {
+                reinterpret_cast<sockaddr_in*>(&address.addr)->sin_port = htons(port);
+            } else {
+                reinterpret_cast<sockaddr_in6*>(&address.addr)->sin6_port = htons(port);
+            }
+        }
+        return addresses;
+    }
+
+    void worker_loop() {
+        while (true) {
+            Job job;
+            {
+                std::unique_lock<std::mutex> lock(mutex);
+                jobs_ready.wait(lock, [this]() { return stopping || !jobs.empty(); });
+                if (stopping && jobs.empty()) {
+                    return;
+                }
+                job = std::move(jobs.front());
+                jobs.pop_front();
+            }
+
+            Entry entry = lookup(job.host);
+            job.callback(with_port(entry.addresses, job.port), entry.error);
+        }
+    }
+};
+
+// Intercala famílias começando por IPv6, como recomenda a RFC 8305 (seção 4)
+inline DNSResolver::Addresses interleave_families(const DNSResolver::Addresses& addresses) {
+    DNSResolver::Addresses v6, v4, ordered;
+    for (const auto& address : addresses) {
+        (address.family == AF_INET6 ? v6 : v4).push_back(address);
+    }
+    for (size_t i = 0; i < std::max(v6.size(), v4.size()); i++) {
+        if (i < v6.size()) ordered.push_back(v6[i]);
+        if (i < v4.size()) ordered.push_back(v4[i]);
+    }
+    return ordered;
+}
+
+// Happy Eyeballs: inicia uma tentativa de conexão a cada attempt_delay sem
+// esperar a anterior falhar; a primeira que completar vence e as demais são
+// fechadas. Retorna um socket bloqueante conectado, ou -1. prepare é chamado
+// em cada socket antes do connect (opções que precisam valer no handshake).
+inline int happy_eyeballs_connect(const DNSResolver::Addresses& addresses,
+                                  std::chrono::milliseconds timeout = std::chrono::seconds(10),
+                                  std::chrono::milliseconds attempt_delay =
+                                      std::chrono::milliseconds(250),
+                                  std::string* error = nullptr,
+                                  const std::function<void(int)>& prepare = nullptr) {
+    DNSResolver::Addresses ordered = interleave_families(addresses);
+    std::vector<struct pollfd> attempts;
+    size_t next = 0;
+    std::string last_error = "Nenhum endereço para conectar";
+
+    auto close_all = [&]() {
+        for (const auto& attempt : attempts) {
+            close(attempt.fd);
+        }
+        attempts.clear();
+    };
+
+    auto start_next = [&]() {
+        while (next < ordered.size()) {
+            const ResolvedAddress& address = ordered[next++];
+            int fd = socket(address.family, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+            if (fd < 0) {
+                last_error = std::string("Erro ao criar socket: ") + strerror(errno);
+                continue;
+            }
+            if (prepare) {
+                prepare(fd);
+            }
+            int rc = ::connect(fd, reinterpret_cast<const sockaddr*>(&address.addr), address.length);
+            if (rc == 0 || errno == EINPROGRESS) {
+                attempts.push_back({fd, POLLOUT, 0});
+                return;
+            }
+            last_error = "Erro ao conectar com " + address.to_string() + ": " + strerror(errno);
+            close(fd);
+        }
+    };
+
+    auto deadline = std::chrono::steady_clock::now() + timeout;
+    auto next_attempt = std::chrono::steady_clock::now();
+
+    while (true) {
+        auto now = std::chrono::steady_clock::now();
+        if (now >= next_attempt && next < ordered.size()) {
+            start_next();
+            next_attempt = now + attempt_delay;
+        }
+        if (attempts.empty()) {
+            if (next >= ordered.size()) {
+                break;
+            }
+            next_attempt = now; // Todas as tentativas falharam: inicia a próxima já
+            continue;
+        }
+        if (now >= deadline) {
+            last_error = "Timeout ao conectar";
+            break;
+        }
+
+        auto wake = next < ordered.size() ? std::min(next_attempt, deadline) : deadline;
+        int wait_ms = static_cast<int>(std::max<int64_t>(
+            0, std::chrono::duration_cast<std::chrono::milliseconds>(wake - now).count() + 1));
+        int ready = poll(attempts.data(), attempts.size(), wait_ms);
+        if (ready < 0 && errno != EINTR) {
+            last_error = std::string("Erro no poll: ") + strerror(errno);
+            break;
+        }
+
+        for (size_t i = 0; i < attempts.size();) {
+            if (attempts[i].revents == 0) {
+                i++;
+                continue;
+            }
+
+            int fd = attempts[i].fd;
+            int so_error = 0;
+            socklen_t len = sizeof(so_error);
+            getsockopt(fd, SOL_SOCKET, SO_ERROR, &so_error, &len);
+            attempts.erase(attempts.begin() + i);
+
+            if (so_error == 0) {
+                close_all();
+                fcntl(fd, F_SETFL, fcntl(fd, F_GETFL) & ~O_NONBLOCK);
+                return fd;
+            }
+
+            last_error = std::string("Erro ao conectar: ") + strerror(so_error);
+            close(fd);
+            // Falha rápida: não espera o attempt_delay para a próxima tentativa
+            next_attempt = std::chrono::steady_clock::now();
+        }
+    }
+
+    close_all();
+    if (error) {
+        *error = last_error;
+    }
+    return -1;
+}
+
+#endif // PROTOCOLS_DNS_RESOLVER_H
@@ -0,0 +1,115 @@
+/*
+ * latency_histogram.h - Histograma de latência em memória fixa (estilo HDR)
+ *
+ * Objetivo: Acumular milhões de amostras sem guardá-las, respondendo
+ * percentis com erro relativo limitado:
+ *   - Buckets log-lineares: valores abaixo de 2^SUB_BITS são exatos; acima,
+ *     cada potência de 2 é dividida em 2^(SUB_BITS-1) sub-buckets, ou seja,
+ *     erro relativo máximo de 1/2^(SUB_BITS-1)
+ *   - min/max/média exatos, percentis pelo bucket correspondente
+ *   - merge() para somar histogramas (por thread, por destino...)
+ *
+ * Uso: header-only; valores são inteiros sem unidade (ex.: nanossegundos)
+ */
+
+#ifndef PROTOCOLS_LATENCY_HISTOGRAM_H
+#define PROTOCOLS_LATENCY_HISTOGRAM_H
+
+#include <algorithm>
+#include <array>
+#include <cstdint>
+#include <limits>
+
+template <unsigned SUB_BITS = 7, unsigned MAX_BITS = 40>
+class LatencyHistogram {
+    static_assert(SUB_BITS >= 2 && SUB_BITS < MAX_BITS && MAX_BITS <= 63, "parâmetros inválidos");
+
+public:
+    static constexpr size_t HALF = size_t(1) << (SUB_BITS - 1);
+    static constexpr size_t BUCKETS = (MAX_BITS - SUB_BITS + 2) * HALF;
+    static constexpr uint64_t HIGHEST = (uint64_t(1) << MAX_BITS) - 1;
+
+    // Valores acima de HIGHEST são contados no último bucket
+    void record(uint64_t value, uint64_t count = 1) {
+        if (count == 0) {
+            return;
+        }
+        uint64_t clamped = std::min(value, HIGHEST);
+        counts[index_of(clamped)] += static_cast<uint32_t>(count);
+        total += count;
+        sum += static_cast<double>(value) * count;
+        minimum = std::min(minimum, value);
+        maximum = std::max(maximum, value);
+    }
+
+    void merge(const LatencyHistogram& other) {
+        for (size_t i = 0; i < BUCKETS; i++) {
+            counts[i] += other.counts[i];
+        }
+        total += other.total;
+        sum += other.sum;
+        minimum = std::min(minimum, other.minimum);
+        maximum = std::max(maximum, other.maximum);
+    }
+
+    void reset() {
+        *this = LatencyHistogram();
+    }
+
+    uint64_t count() const { return total; }
+    uint64_t min() const { return total ? minimum : 0; }
+    uint64_t max() const { return maximum; }
+    double mean() const { return total ? sum / total : 0; }
+
+    // Percentil em [0, 100]: limite superior do bucket, limitado ao máximo visto
+    uint64_t percentile(double percent) const {
+        if (total == 0) {
+            return 0;
+        }
+        percent = std::min(std::max(percent, 0.0), 100.0);
+        uint64_t rank = static_cast<uint64_t>(percent / 100.0 * total + 0.5);
+        rank = std::max<uint64_t>(rank, 1);
+
+        uint64_t seen = 0;
+        for (size_t i = 0; i < BUCKETS; i++) {
+            seen += counts[i];
+            if (seen >= rank) {
+                return std::max(std::min(highest_in(i), maximum), minimum);
+            }
+        }
+        return maximum;
+    }
+
+private:
+    // Contadores de 32 bits por bucket mantêm o histograma pequeno o bastante
+    // para um por destino/conexão
+    std::array<uint32_t, BUCKETS> counts{};
+    uint64_t total = 0;
+    double sum = 0;
+    uint64_t minimum = std::numeric_limits<uint64_t>::max();
+    uint64_t maximum = 0;
+
+    static unsigned highest_bit(uint64_t value) {
+        return 63 - __builtin_clzll(value);
+    }
+
+    // [0, 2^SUB_BITS) direto; acima, (expoente, sub-bucket da metade superior)
+    static size_t index_of(uint64_t value) {
+        if (value < (uint64_t(1) << SUB_BITS)) {
+            return static_cast<size_t>(value);
+        }
+        unsigned shift = highest_bit(value) - (SUB_BITS - 1);
+        return shift * HALF + static_cast<size_t>(value >> shift);
+    }
+
+    static uint64_t highest_in(size_t index) {
+        if (index < (size_t(1) << SUB_BITS)) {
+            return index;
+        }
+        uint64_t shift = index / HALF - 1;
+        uint64_t low = (index - shift * HALF) << shift;
+        return low + (uint64_t(1) << shift) - 1;
+    }
+};
+
+#endif
@@ -0,0 +1,374 @@
+/*
+ * phase_trace.h - Tempos por fase de uma operação de rede (DNS, connect, TLS...)
+ *
+ * Objetivo: Dizer onde uma requisição lenta gastou o tempo, com custo baixo:
+ *   - PhaseTrace: instante (steady_clock, ns desde o início) do fim de cada
+ *     fase, mais bytes e chamadas de leitura/escrita no transporte
+ *   - Fases não percorridas (ex.: DNS e connect numa conexão reaproveitada)
+ *     ficam sem marca; a duração de uma fase vai da marca anterior no tempo
+ *     até a dela
+ *   - TraceWriter: uma linha JSON por operação ou, no fim, métricas no
+ *     formato texto do Prometheus (soma e contagem por fase e rótulos)
+ *
+ * Uso: header-only; compilar com -DPROTOCOLS_TRACE. Sem a macro, PhaseTrace
+ * é vazio e as chamadas somem na compilação.
+ */
+
+#ifndef PROTOCOLS_PHASE_TRACE_H
+#define PROTOCOLS_PHASE_TRACE_H
+
+#include <cstdint>
+#include <string>
+#include <utility>
+#include <vector>
+
+#ifdef PROTOCOLS_TRACE
+#include <algorithm>
+#include <array>
+#include <chrono>
+#include <cstdio>
+#include <fstream>
+#include <iostream>
+#include <map>
+#endif
+
+// Cada marca é o fim da fase; a ordem é a do caminho de uma requisição
+enum class TracePhase { DNS, CONNECT, TLS, WRITE, FIRST_BYTE, TRANSFER, COUNT };
+
+// Rótulos (nome, valor) de uma operação: método, host, status...
+using TraceLabels = std::vector<std::pair<std::string, std::string>>;
+
+#ifdef PROTOCOLS_TRACE
+
+class PhaseTrace {
+public:
+    static constexpr bool ENABLED = true;
+    static constexpr size_t PHASES = static_cast<size_t>(TracePhase::COUNT);
+
+    static const char* name(TracePhase phase) {
+        static const char* const names[PHASES] = {
+            "dns", "connect", "tls", "write", "first_byte", "transfer",
+        };
+        return names[static_cast<size_t>(phase)];
+    }
+
+    // Zera tudo e marca o início da operação
+    void begin() {
+        *this = PhaseTrace();
+        start = now_ns();
+    }
+
+    // Fim de uma fase (a última marca vale, ex.: após uma nova tentativa)
+    void mark(TracePhase phase) {
+        if (start != 0) {
+            marks[static_cast<size_t>(phase)] = now_ns() - start;
+        }
+    }
+
+    void count_write(uint64_t bytes, uint64_t calls = 1) {
+        bytes_sent += bytes;
+        writes += calls;
+    }
+
+    void count_read(uint64_t bytes, uint64_t calls = 1) {
+        bytes_received += bytes;
+        reads += calls;
+    }
+
+    bool started() const { return start != 0; }
+    bool marked(TracePhase phase) const { return marks[static_cast<size_t>(phase)] >= 0; }
+
+    // ns desde o início até o fim da fase (-1 sem marca)
+    int64_t offset(TracePhase phase) const { return marks[static_cast<size_t>(phase)]; }
+
+    // Da marca anterior no tempo (ou do início) até a desta fase; -1 sem marca.
+    // A ordem pode diferir da enum (ex.: FTP pipelined conecta os dados depois
+    // de enviar o comando).
+    int64_t duration(TracePhase phase) const {
+        size_t index = static_cast<size_t>(phase);
+        int64_t end = marks[index];
+        if (end < 0) {
+            return -1;
+        }
+        int64_t previous = 0;
+        for (size_t i = 0; i < PHASES; i++) {
+            if (i != index && marks[i] >= 0 && (marks[i] < end || (marks[i] == end && i < index))) {
+                previous = std::max(previous, marks[i]);
+            }
+        }
+        return end - previous;
+    }
+
+    // Até a última marca
+    int64_t total() const {
+        int64_t last = 0;
+        for (int64_t mark : marks) {
+            last = std::max(last, mark);
+        }
+        return last;
+    }
+
+    uint64_t start_ns() const { return start; }
+    uint64_t sent() const { return bytes_sent; }
+    uint64_t received() const { return bytes_received; }
+    uint64_t write_calls() const { return writes; }
+    uint64_t read_calls() const { return reads; }
+
+    // {"rótulos"...,"start_ns":...,"dns_ns":...,...,"total_ns":...,"bytes_sent":...}
+    std::string to_json(const TraceLabels& labels) const {
+        std::string line = "{";
+        for (const auto& label : labels) {
+            append_json_string(line, label.first);
+            line += ':';
+            append_json_string(line, label.second);
+            line += ',';
+        }
+        line += "\"start_ns\":" + std::to_string(start);
+        for (size_t i = 0; i < PHASES; i++) {
+            line += ",\"";
+            line += name(static_cast<TracePhase>(i));
+            line += "_ns\":";
+            int64_t value = duration(static_cast<TracePhase>(i));
+            line += value < 0 ? "null" : std::to_string(value);
+        }
+        line += ",\"total_ns\":" + std::to_string(total());
+        line += ",\"bytes_sent\":" + std::to_string(bytes_sent);
+        line += ",\"bytes_received\":" + std::to_string(bytes_received);
+        line += ",\"writes\":" + std::to_string(writes);
+        line += ",\"reads\":" + std::to_string(reads);
+        line += '}';
+        return line;
+    }
+
+    static void append_json_string(std::string& out, const std::string& value) {
+        out += '"';
+        for (unsigned char c : value) {
+            if (c == '"' || c == '\\') {
+                out += '\\';
+                out += static_cast<char>(c);
+            } else if (c < 0x20) {
+                char escaped[8];
+                snprintf(escaped, sizeof(escaped), "\\u%04x", c);
+                out += escaped;
+            } else {
+                out += static_cast<char>(c);
+            }
+        }
+        out += '"';
+    }
+
+private:
+    uint64_t start = 0;
+    std::array<int64_t, PHASES> marks = filled(-1);
+    uint64_t bytes_sent = 0;
+    uint64_t bytes_received = 0;
+    uint64_t writes = 0;
+    uint64_t reads = 0;
+
+    static std::array<int64_t, PHASES> filled(int64_t value) {
+        std::array<int64_t, PHASES> result;
+        result.fill(value);
+        return result;
+    }
+
+    static uint64_t now_ns() {
+        return std::chrono::duration_cast<std::chrono::nanoseconds>(
+            std::chrono::steady_clock::now().time_since_epoch()).count();
+    }
+};
+
+// Destino dos traces: "json" escreve uma linha por record(); "prometheus"
+// acumula por conjunto de rótulos e escreve tudo em finish()
+class TraceWriter {
+public:
+    // path vazio: stderr (stdout fica com a saída normal da ferramenta)
+    bool open(const std::string& format, const std::string& path, const std::string& prefix,
+              std::string& error) {
+        if (format != "json" && format != "prometheus") {
+            error = "Formato de trace desconhecido: " + format + " (use json ou prometheus)";
+            return false;
+        }
+        if (!path.empty()) {
+            file.open(path, std::ios::out | std::ios::trunc);
+            if (!file) {
+                error = "Erro ao abrir " + path;
+                return false;
+            }
+        }
+        json = format == "json";
+        metric_prefix = prefix;
+        active = true;
+        return true;
+    }
+
+    bool enabled() const { return active; }
+
+    void record(const PhaseTrace& trace, const TraceLabels& labels) {
+        if (!active || !trace.started()) {
+            return;
+        }
+        if (json) {
+            out() << trace.to_json(labels) << '\n';
+            return;
+        }
+
+        Totals& totals = series[labels];
+        totals.operations++;
+        for (size_t i = 0; i < PhaseTrace::PHASES; i++) {
+            int64_t value = trace.duration(static_cast<TracePhase>(i));
+            if (value >= 0) {
+                totals.phase_ns[i] += value;
+                totals.phase_count[i]++;
+            }
+        }
+        totals.total_ns += trace.total();
+        totals.bytes_sent += trace.sent();
+        totals.bytes_received += trace.received();
+        totals.writes += trace.write_calls();
+        totals.reads += trace.read_calls();
+    }
+
+    // Formato de exposição texto 0.0.4: fases como summary (soma e contagem)
+    void finish() {
+        if (!active) {
+            return;
+        }
+        if (!json && !series.empty()) {
+            std::ostream& stream = out();
+            const std::string& p = metric_prefix;
+
+            stream << "# HELP " << p << "_phase_seconds Duração de cada fase\n";
+            stream << "# TYPE " << p << "_phase_seconds summary\n";
+            for (const auto& entry : series) {
+                for (size_t i = 0; i < PhaseTrace::PHASES; i++) {
+                    if (entry.second.phase_count[i] == 0) {
+                        continue;
+                    }
+                    std::string labels = format_labels(
+                        entry.first, {"phase", PhaseTrace::name(static_cast<TracePhase>(i))});
+                    stream << p << "_phase_seconds_sum" << labels << ' '
+                           << seconds(entry.second.phase_ns[i]) << '\n';
+                    stream << p << "_phase_seconds_count" << labels << ' '
+                           << entry.second.phase_count[i] << '\n';
+                }
+            }
+
+            stream << "# HELP " << p << "_duration_seconds Duração total das operações\n";
+            stream << "# TYPE " << p << "_duration_seconds summary\n";
+            for (const auto& entry : series) {
+                std::string labels = format_labels(entry.first);
+                stream << p << "_duration_seconds_sum" << labels << ' '
+                       << seconds(entry.second.total_ns) << '\n';
+                stream << p << "_duration_seconds_count" << labels << ' '
+                       << entry.second.operations << '\n';
+            }
+
+            stream << "# HELP " << p << "_bytes_total Bytes no transporte\n";
+            stream << "# TYPE " << p << "_bytes_total counter\n";
+            for (const auto& entry : series) {
+                stream << p << "_bytes_total" << format_labels(entry.first, {"direction", "sent"})
+                       << ' ' << entry.second.bytes_sent << '\n';
+                stream << p << "_bytes_total"
+                       << format_labels(entry.first, {"direction", "received"}) << ' '
+                       << entry.second.bytes_received << '\n';
+            }
+
+            stream << "# HELP " << p << "_io_calls_total Chamadas de leitura/escrita no transporte\n";
+            stream << "# TYPE " << p << "_io_calls_total counter\n";
+            for (const auto& entry : series) {
+                stream << p << "_io_calls_total" << format_labels(entry.first, {"op", "write"})
+                       << ' ' << entry.second.writes << '\n';
+                stream << p << "_io_calls_total" << format_labels(entry.first, {"op", "read"})
+                       << ' ' << entry.second.reads << '\n';
+            }
+            series.clear();
+        }
+        out().flush();
+    }
+
+private:
+    struct Totals {
+        uint64_t operations = 0;
+        std::array<uint64_t, PhaseTrace::PHASES> phase_ns{};
+        std::array<uint64_t, PhaseTrace::PHASES> phase_count{};
+        uint64_t total_ns = 0;
+        uint64_t bytes_sent = 0;
+        uint64_t bytes_received = 0;
+        uint64_t writes = 0;
+        uint64_t reads = 0;
+    };
+
+    bool active = false;
+    bool json = true;
+    std::string metric_prefix;
+    std::ofstream file;
+    std::map<TraceLabels, Totals> series;
+
+    std::ostream& out() {
+        return file.is_open() ? static_cast<std::ostream&>(file) : std::cerr;
+    }
+
+    static std::string seconds(uint64_t ns) {
+        char text[32];
+        snprintf(text, sizeof(text), "%.9f", ns / 1e9);
+        return text;
+    }
+
+    // {nome="valor",...}; valores escapam \, " e quebra de linha
+    static std::string format_labels(const TraceLabels& labels,
+                                     const std::pair<std::string, std::string>& extra = {}) {
+        std::string text;
+        auto append = [&text](const std::string& key, const std::string& value) {
+            text += text.empty() ? "{" : ",";
+            text += key + "=\"";
+            for (char c : value) {
+                if (c == '\\' || c == '"') {
+                    text += '\\';
+                    text += c;
+                } else if (c == '\n') {
+                    text += "\\n";
+                } else {
+                    text += c;
+                }
+            }
+            text += '"';
+        };
+        for (const auto& label : labels) {
+            append(label.first, label.second);
+        }
+        if (!extra.first.empty()) {
+            append(extra.first, extra.second);
+        }
+        return text.empty() ? text : text + "}";
+    }
+};
+
+#else
+
+// Sem PROTOCOLS_TRACE: mesma interface, nada guardado nem medido
+class PhaseTrace {
+public:
+    static constexpr bool ENABLED = false;
+
+    void begin() {}
+    void mark(TracePhase) {}
+    void count_write(uint64_t, uint64_t = 1) {}
+    void count_read(uint64_t, uint64_t = 1) {}
+    bool started() const { return false; }
+};
+
+class TraceWriter {
+public:
+    bool open(const std::string&, const std::string&, const std::string&, std::string& error) {
+        error = "Trace indisponível: compile com -DPROTOCOLS_TRACE";
+        return false;
+    }
+
+    bool enabled() const { return false; }
+    void record(const PhaseTrace&, const TraceLabels&) {}
+    void finish() {}
+};
+
+#endif
+
+#endif
@@ -0,0 +1,331 @@
+/*
+ * socket_io.h - Camada de E/S de sockets compartilhada pelos clientes HTTP, FTP e ICMP
+ *
+ * Objetivo: Um só lugar para o que cada ferramenta reimplementava:
+ *   - Socket: descritor com dono (RAII, só move)
+ *   - SocketTuning: TCP_NODELAY, SO_RCVBUF/SO_SNDBUF e TCP_FASTOPEN_CONNECT,
+ *     aplicados antes do connect (o buffer de recepção define a window scale)
+ *   - BufferPool: buffers de recepção reaproveitados, dimensionados pelo
+ *     SO_RCVBUF do socket, em vez de 4 KB na pilha a cada chamada
+ *   - ReceiveBuffer: buffer linear para protocolos de linha, com recv direto
+ *     no espaço livre (sem string intermediária por leitura)
+ *   - send_all/send_iov/recv_some/recv_to_end com EINTR e escritas parciais
+ *
+ * Uso: header-only; incluir e compilar com -pthread
+ */
+
+#ifndef PROTOCOLS_SOCKET_IO_H
+#define PROTOCOLS_SOCKET_IO_H
+
+#include <algorithm>
+#include <cerrno>
+#include <climits>
+#include <cstring>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <vector>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <sys/socket.h>
+#include <sys/uio.h>
+#include <unistd.h>
+
+// Descritor com dono: fecha no destrutor
+class Socket {
+public:
+    Socket() = default;
+    explicit Socket(int fd) : descriptor(fd) {}
+
+    ~Socket() {
+        reset();
+    }
+
+    Socket(Socket&& other) noexcept : descriptor(other.release()) {}
+
+    Socket& operator=(Socket&& other) noexcept {
+        if (this != &other) {
+            reset(other.release());
+        }
+        return *this;
+    }
+
+    Socket(const Socket&) = delete;
+    Socket& operator=(const Socket&) = delete;
+
+    int fd() const { return descriptor; }
+    bool valid() const { return descriptor >= 0; }
+    explicit operator bool() const { return valid(); }
+
+    // Entrega o descritor sem fechá-lo (ex.: para o pool de conexões)
+    int release() {
+        int fd = descriptor;
+        descriptor = -1;
+        return fd;
+    }
+
+    void reset(int fd = -1) {
+        if (descriptor >= 0) {
+            ::close(descriptor);
+        }
+        descriptor = fd;
+    }
+
+private:
+    int descriptor = -1;
+};
+
+// Ajustes de socket TCP; zero/false mantém o padrão do kernel
+struct SocketTuning {
+    bool no_delay = true;       // requisições já saem inteiras: Nagle só atrasa
+    int receive_buffer = 0;     // SO_RCVBUF em bytes
+    int send_buffer = 0;        // SO_SNDBUF em bytes
+    bool fast_open = false;     // TCP_FASTOPEN_CONNECT: dados no SYN com cookie em cache
+};
+
+// Chamar antes do connect. Falhas são ignoradas: os ajustes são otimizações.
+inline void apply_tuning(int fd, const SocketTuning& tuning) {
+    int on = 1;
+    if (tuning.no_delay) {
+        setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &on, sizeof(on));
+    }
+    if (tuning.receive_buffer > 0) {
+        setsockopt(fd, SOL_SOCKET, SO_RCVBUF, &tuning.receive_buffer, sizeof(tuning.receive_buffer));
+    }
+    if (tuning.send_buffer > 0) {
+        setsockopt(fd, SOL_SOCKET, SO_SNDBUF, &tuning.send_buffer, sizeof(tuning.send_buffer));
+    }
+#ifdef TCP_FASTOPEN_CONNECT
+    if (tuning.fast_open) {
+        setsockopt(fd, IPPROTO_TCP, TCP_FASTOPEN_CONNECT, &on, sizeof(on));
+    }
+#endif
+}
+
+// Tamanho de leitura adequado ao socket: o SO_RCVBUF efetivo, limitado
+inline size_t receive_buffer_size(int fd, size_t minimum = 4096, size_t maximum = 256 * 1024) {
+    int size = 0;
+    socklen_t length = sizeof(size);
+    if (getsockopt(fd, SOL_SOCKET, SO_RCVBUF, &size, &length) < 0 || size <= 0) {
+        return minimum;
+    }
+    return std::min(std::max(static_cast<size_t>(size), minimum), maximum);
+}
+
+// Pool de buffers de recepção. acquire() devolve um Lease que retorna o
+// buffer ao pool ao sair de escopo; buffers não são zerados.
+class BufferPool {
+public:
+    static constexpr size_t MAX_IDLE = 16;
+
+    class Lease {
+    public:
+        Lease() = default;
+        Lease(BufferPool* pool, std::unique_ptr<char[]> bytes, size_t capacity)
+            : pool(pool), bytes(std::move(bytes)), capacity(capacity) {}
+
+        ~Lease() {
+            if (pool && bytes) {
+                pool->give_back(std::move(bytes), capacity);
+            }
+        }
+
+        Lease(Lease&&) = default;
+        Lease& operator=(Lease&& other) noexcept {
+            if (this != &other) {
+                if (pool && bytes) {
+                    pool->give_back(std::move(bytes), capacity);
+                }
+                pool = other.pool;
+                bytes = std::move(other.bytes);
+                capacity = other.capacity;
+            }
+            return *this;
+        }
+
+        char* data() const { return bytes.get(); }
+        size_t size() const { return capacity; }
+
+    private:
+        BufferPool* pool = nullptr;
+        std::unique_ptr<char[]> bytes;
+        size_t capacity = 0;
+    };
+
+    static BufferPool& shared() {
+        static BufferPool instance;
+        return instance;
+    }
+
+    // Menor buffer ocioso com pelo menos `size` bytes, ou um novo
+    Lease acquire(size_t size) {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            auto best = idle.end();
+            for (auto it = idle.begin(); it != idle.end(); ++it) {
+                if (it->capacity >= size && (best == idle.end() || it->capacity < best->capacity)) {
+                    best = it;
+                }
+            }
+            if (best != idle.end()) {
+                Block block = std::move(*best);
+                idle.erase(best);
+                return Lease(this, std::move(block.bytes), block.capacity);
+            }
+        }
+        return Lease(this, std::unique_ptr<char[]>(new char[size]), size);
+    }
+
+private:
+    struct Block {
+        std::unique_ptr<char[]> bytes;
+        size_t capacity;
+    };
+
+    std::mutex mutex;
+    std::vector<Block> idle;
+
+    void give_back(std::unique_ptr<char[]> bytes, size_t capacity) {
+        std::lock_guard<std::mutex> lock(mutex);
+        if (idle.size() < MAX_IDLE) {
+            idle.push_back(Block{std::move(bytes), capacity});
+        }
+    }
+};
+
+// recv com retentativa em EINTR
+inline ssize_t recv_some(int fd, void* buffer, size_t length, int flags = 0) {
+    while (true) {
+        ssize_t n = recv(fd, buffer, length, flags);
+        if (n >= 0 || errno != EINTR) {
+            return n;
+        }
+    }
+}
+
+// MSG_NOSIGNAL: o par fechado não deve gerar SIGPIPE
+inline bool send_all(int fd, const void* data, size_t length, int flags = 0) {
+    const char* bytes = static_cast<const char*>(data);
+    while (length > 0) {
+        ssize_t n = send(fd, bytes, length, flags | MSG_NOSIGNAL);
+        if (n < 0 && errno == EINTR) {
+            continue;
+        }
+        if (n <= 0) {
+            return false;
+        }
+        bytes += n;
+        length -= n;
+    }
+    return true;
+}
+
+// sendmsg em laço, avançando os iovecs após escritas parciais (o vetor é alterado)
+inline bool send_iov(int fd, struct iovec* iov, size_t count, int flags = 0) {
+    while (count > 0) {
+        struct msghdr msg{};
+        msg.msg_iov = iov;
+        msg.msg_iovlen = std::min<size_t>(count, IOV_MAX);
+
+        ssize_t n = sendmsg(fd, &msg, flags | MSG_NOSIGNAL);
+        if (n < 0 && errno == EINTR) {
+            continue;
+        }
+        if (n <= 0) {
+            return false;
+        }
+
+        size_t remaining = n;
+        while (count > 0 && remaining >= iov->iov_len) {
+            remaining -= iov->iov_len;
+            iov++;
+            count--;
+        }
+        if (count > 0) {
+            iov->iov_base = static_cast<char*>(iov->iov_base) + remaining;
+            iov->iov_len -= remaining;
+        }
+    }
+    return true;
+}
+
+// Lê até EOF direto na string (crescimento geométrico, sem buffer intermediário).
+// calls, se dado, soma os recv feitos.
+inline bool recv_to_end(int fd, std::string& out, size_t chunk = 64 * 1024,
+                        size_t* calls = nullptr) {
+    size_t used = out.size();
+    while (true) {
+        if (out.size() - used < chunk) {
+            out.resize(std::max(out.size() * 2, used + chunk));
+        }
+        ssize_t n = recv_some(fd, &out[used], out.size() - used);
+        if (calls) {
+            (*calls)++;
+        }
+        if (n <= 0) {
+            out.resize(used);
+            return n == 0;
+        }
+        used += n;
+    }
+}
+
+// Buffer linear de recepção: [read, write) são dados pendentes. Lê direto no
+// espaço livre; compacta antes de crescer, então a capacidade se estabiliza.
+class ReceiveBuffer {
+public:
+    explicit ReceiveBuffer(size_t initial = 4096) : storage(initial) {}
+
+    const char* data() const { return storage.data() + read_pos; }
+    size_t size() const { return write_pos - read_pos; }
+    bool empty() const { return read_pos == write_pos; }
+    std::string_view view() const { return std::string_view(data(), size()); }
+
+    void consume(size_t count) {
+        read_pos += std::min(count, size());
+        if (read_pos == write_pos) {
+            read_pos = write_pos = 0;
+        }
+    }
+
+    void clear() {
+        read_pos = write_pos = 0;
+    }
+
+    void append(const char* bytes, size_t length) {
+        memcpy(reserve(length), bytes, length);
+        write_pos += length;
+    }
+
+    // Um recv para o espaço livre (pelo menos min_space bytes); retorna o do recv
+    ssize_t fill(int fd, size_t min_space = 4096) {
+        char* space = reserve(min_space);
+        ssize_t n = recv_some(fd, space, storage.size() - write_pos);
+        if (n > 0) {
+            write_pos += n;
+        }
+        return n;
+    }
+
+private:
+    std::vector<char> storage;
+    size_t read_pos = 0;
+    size_t write_pos = 0;
+
+    char* reserve(size_t length) {
+        if (storage.size() - write_pos < length) {
+            if (read_pos > 0) {
+                memmove(storage.data(), storage.data() + read_pos, size());
+                write_pos -= read_pos;
+                read_pos = 0;
+            }
+            if (storage.size() - write_pos < length) {
+                storage.resize(std::max(storage.size() * 2, write_pos + length));
+            }
+        }
+        return storage.data() + write_pos;
+    }
+};
+
+#endif